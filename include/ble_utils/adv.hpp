@@ -0,0 +1,187 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file adv.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Compile-time packer of service UUIDs for advertising and scan response data
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ble_utils::adv
+{
+
+/**
+ * @brief Maximum payload of the advertising PDU the data is packed for
+ */
+enum class Payload : uint16_t
+{
+    Legacy = BT_GAP_ADV_MAX_ADV_DATA_LEN,       /*!< Legacy advertising (31 bytes) */
+    Extended = BT_GAP_ADV_MAX_EXT_ADV_DATA_LEN  /*!< Extended advertising */
+};
+
+namespace detail
+{
+/*! @brief Size of the AD element header (length and type) */
+static constexpr size_t AD_HDR_SIZE{2U};
+/*! @brief Maximum data of a single AD element (the length field also counts the type) */
+static constexpr size_t AD_MAX_DATA_LEN{UINT8_MAX - 1U};
+
+constexpr size_t put(const bt_uuid_16 &uuid, uint8_t *dst)
+{
+    dst[0] = static_cast<uint8_t>(uuid.val & 0xFF);
+    dst[1] = static_cast<uint8_t>(uuid.val >> 8 & 0xFF);
+    return BT_UUID_SIZE_16;
+}
+
+constexpr size_t put(const bt_uuid_32 &uuid, uint8_t *dst)
+{
+    dst[0] = static_cast<uint8_t>(uuid.val & 0xFF);
+    dst[1] = static_cast<uint8_t>(uuid.val >> 8 & 0xFF);
+    dst[2] = static_cast<uint8_t>(uuid.val >> 16 & 0xFF);
+    dst[3] = static_cast<uint8_t>(uuid.val >> 24 & 0xFF);
+    return BT_UUID_SIZE_32;
+}
+
+constexpr size_t put(const bt_uuid_128 &uuid, uint8_t *dst)
+{
+    for (size_t i = 0; i < BT_UUID_SIZE_128; i++) {
+        dst[i] = uuid.val[i];
+    }
+    return BT_UUID_SIZE_128;
+}
+
+constexpr size_t ad_size(size_t data_len)
+{
+    return data_len > 0 ? AD_HDR_SIZE + data_len : 0U;
+}
+} // namespace detail
+
+/**
+ * @brief Service UUID list packed at compile time into AD elements
+ * @details The UUIDs are grouped by type into a single UUID16, UUID32 and UUID128
+ *          element each, so only one AD header is spent per UUID type. The total size
+ *          is checked against the advertising payload limit at compile time. <br>
+ *          Example: <br>
+ *          using scan_rsp = ble_utils::adv::ServiceUuids<ble_utils::adv::Payload::Legacy,
+ *                                                        true,
+ *                                                        my_svc_uuid,
+ *                                                        other_svc_uuid>;
+ *          bt_le_adv_start(&param, ad, ARRAY_SIZE(ad), scan_rsp::data(), scan_rsp::count);
+ *
+ * @tparam Limit Payload limit of the advertising data
+ * @tparam Complete true for a complete list (UUID*_ALL), false for an incomplete one (UUID*_SOME)
+ * @tparam Uuids Static bt_uuid_16, bt_uuid_32 or bt_uuid_128 objects (e.g. the service UUIDs)
+ */
+template<Payload Limit, bool Complete, const auto &... Uuids>
+class ServiceUuids
+{
+    static_assert(sizeof...(Uuids) > 0, "At least one UUID is required");
+
+    static constexpr size_t cnt(uint8_t type)
+    {
+        return (0U + ... + (Uuids.uuid.type == type ? 1U : 0U));
+    }
+
+    /*! @brief Byte storage that is never zero sized */
+    template<size_t N>
+    struct Bytes
+    {
+        uint8_t val[N > 0 ? N : 1];
+    };
+
+    template<uint8_t Type, size_t N>
+    static constexpr Bytes<N> pack()
+    {
+        Bytes<N> bytes{};
+        size_t pos = 0;
+        ((pos += Uuids.uuid.type == Type ? detail::put(Uuids, &bytes.val[pos]) : 0U), ...);
+        return bytes;
+    }
+
+    static constexpr size_t len16 = cnt(BT_UUID_TYPE_16) * BT_UUID_SIZE_16;
+    static constexpr size_t len32 = cnt(BT_UUID_TYPE_32) * BT_UUID_SIZE_32;
+    static constexpr size_t len128 = cnt(BT_UUID_TYPE_128) * BT_UUID_SIZE_128;
+
+    static_assert(len16 <= detail::AD_MAX_DATA_LEN &&
+                  len32 <= detail::AD_MAX_DATA_LEN &&
+                  len128 <= detail::AD_MAX_DATA_LEN,
+                  "UUIDs of one type do not fit into a single AD element");
+
+    static constexpr Bytes<len16> uuid16 = pack<BT_UUID_TYPE_16, len16>();
+    static constexpr Bytes<len32> uuid32 = pack<BT_UUID_TYPE_32, len32>();
+    static constexpr Bytes<len128> uuid128 = pack<BT_UUID_TYPE_128, len128>();
+
+public:
+    /*! @brief Number of AD elements (one per UUID type in use) */
+    static constexpr size_t count = (len16 > 0) + (len32 > 0) + (len128 > 0);
+
+    /*! @brief Encoded size in bytes including the AD headers */
+    static constexpr size_t size = detail::ad_size(len16) +
+                                   detail::ad_size(len32) +
+                                   detail::ad_size(len128);
+
+    static_assert(size <= static_cast<size_t>(Limit),
+                  "Service UUIDs exceed the advertising payload limit");
+
+private:
+    struct Elements
+    {
+        bt_data val[count];
+    };
+
+    static constexpr Elements build()
+    {
+        Elements elements{};
+        size_t idx = 0;
+        if (len16 > 0) {
+            elements.val[idx++] = {
+                .type = Complete ? BT_DATA_UUID16_ALL : BT_DATA_UUID16_SOME,
+                .data_len = static_cast<uint8_t>(len16),
+                .data = uuid16.val
+            };
+        }
+        if (len32 > 0) {
+            elements.val[idx++] = {
+                .type = Complete ? BT_DATA_UUID32_ALL : BT_DATA_UUID32_SOME,
+                .data_len = static_cast<uint8_t>(len32),
+                .data = uuid32.val
+            };
+        }
+        if (len128 > 0) {
+            elements.val[idx++] = {
+                .type = Complete ? BT_DATA_UUID128_ALL : BT_DATA_UUID128_SOME,
+                .data_len = static_cast<uint8_t>(len128),
+                .data = uuid128.val
+            };
+        }
+        return elements;
+    }
+
+    static constexpr Elements elements = build();
+
+public:
+    /**
+     * @brief Get the packed AD elements
+     *
+     * @return Pointer to @ref count AD elements placed in ROM
+     */
+    static constexpr const bt_data * data()
+    {
+        return elements.val;
+    }
+};
+
+} // namespace ble_utils::adv
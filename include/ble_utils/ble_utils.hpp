@@ -15,6 +15,13 @@
 #pragma once
 
 #include <zephyr/bluetooth/gatt.h>
+#if defined(CONFIG_BLE_UTILS_PUBLISH)
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#endif
+#if defined(CONFIG_BLE_UTILS_BROADCAST)
+#include <ble_utils/broadcast.hpp>
+#endif
 
 namespace ble_utils::gatt
 {
@@ -23,6 +30,12 @@ class ICharacteristicCCC;
 class CharacteristicNotify;
 class Service;
 class CharacteristicIndicate;
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+class CCCTable;
+#endif
+#if defined(CONFIG_BLE_UTILS_SNAPSHOT)
+class Snapshot;
+#endif
 
 /**
  * @brief A BLE Base Characteristic that can have read and write
@@ -91,6 +104,41 @@ public:
         return 0;
     }
 
+    /**
+     * @brief Connection aware variant of @ref read_cb
+     * @details The default implementation discards the connection and calls @ref read_cb.
+     *
+     * @param conn Connection that requested the read
+     * @param buf Buffer to place the read result in
+     * @param len  Length of data to read
+     * @param offset Offset to start reading from
+     * @return Number of bytes read, or in case of an error
+     *          BT_GATT_ERR() with a specific BT_ATT_ERR_* error code.
+     */
+    virtual ssize_t conn_read_cb(bt_conn *conn, void *buf, uint16_t len, uint16_t offset)
+    {
+        ARG_UNUSED(conn);
+        return read_cb(buf, len, offset);
+    }
+
+    /**
+    *  @brief Connection aware variant of @ref write_cb
+    *  @details The default implementation discards the connection and calls @ref write_cb.
+    *
+    *  @param conn Connection that requested the write
+    *  @param buf  Buffer with the data to write
+    *  @param len Number of bytes in the buffer
+    *  @param offset Offset to start writing from
+    *  @param flags  Flags (``BT_GATT_WRITE_FLAG_*``)
+    *  @return Number of bytes written, or in case of an error
+    *          BT_GATT_ERR() with a specific BT_ATT_ERR_* error code.
+    */
+    virtual ssize_t conn_write_cb(bt_conn *conn, const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+    {
+        ARG_UNUSED(conn);
+        return write_cb(buf, len, offset, flags);
+    }
+
     /**
      * @brief Get the UUID of the characteristic
      * 
@@ -103,6 +151,9 @@ private:
     friend Service;
     friend CharacteristicNotify;
     friend CharacteristicIndicate;
+#if defined(CONFIG_BLE_UTILS_SNAPSHOT)
+    friend Snapshot;
+#endif
 
     /**
      * @brief Internal constructor for a Characteristic
@@ -175,10 +226,62 @@ public:
     {
         ARG_UNUSED(value);
     };
+
+    /**
+     * @brief CCC descriptor written by a connection
+     * @details Called for every write, also when the value of all connections
+     *          (see @ref ccc_changed) stays the same. The value might not be applied yet,
+     *          so notifications to the connection must be deferred, e.g. to a work item.
+     *
+     * @param conn Connection that wrote the CCC
+     * @param value The CCC Value that was written
+     */
+    virtual void conn_ccc_written(bt_conn *conn, CCCValue_e value)
+    {
+        ARG_UNUSED(conn);
+        ARG_UNUSED(value);
+    }
     
     virtual ~ICharacteristicCCC() = 0;
+
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+    /**
+     * @brief Check if a connection enabled notifications or indications
+     *
+     * @param conn Connection object
+     * @param type CCC type, BT_GATT_CCC_NOTIFY or BT_GATT_CCC_INDICATE
+     * @return true if the connection is subscribed
+     */
+    bool is_subscribed(const bt_conn *conn, uint16_t type) const;
+#endif
 private:
+    /**
+     * @brief Dispatch a changed CCC value to @ref ccc_changed
+     *
+     * @param value CCC value of all connections
+     */
+    void changed(uint16_t value);
+
+    /**
+     * @brief Dispatch a CCC write of a connection to @ref conn_ccc_written
+     *
+     * @param conn Connection that wrote the CCC
+     * @param value CCC value that was written
+     */
+    void written(bt_conn *conn, uint16_t value);
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+    static ssize_t _ccc_read(bt_conn *conn, const bt_gatt_attr *attr,
+                             void *buf, uint16_t len, uint16_t offset);
+    static ssize_t _ccc_write(bt_conn *conn, const bt_gatt_attr *attr,
+                              const void *buf, uint16_t len, uint16_t offset, uint8_t flags);
+    /*! Index in the shared CCC table */
+    const uint16_t m_ccc_idx;
+    /*! CCC value of all connections */
+    uint16_t m_ccc_value{0};
+    friend CCCTable;
+#else
     static void _ccc_changed(const bt_gatt_attr *attr, uint16_t value);
+    static ssize_t _ccc_cfg_write(bt_conn *conn, const bt_gatt_attr *attr, uint16_t value);
     /**
      * @brief Custom struct to add context for ccc changed callback
      */
@@ -187,8 +290,13 @@ private:
         void * ctx;
     };
     gatt_ccc m_ccc_data;
+#endif
     const bt_gatt_attr m_ccc_attr; 
+    /*! Value attribute in the service it is registered to, set by Service::register_char */
+    mutable const bt_gatt_attr *m_value_attr{nullptr};
     friend Service;
+    friend CharacteristicNotify;
+    friend CharacteristicIndicate;
 };
 
 /**
@@ -223,7 +331,92 @@ public:
      * @return The zephyr gatt result from the internal bt api
      */
     int notify(const void * data,const uint16_t len);
+
+#if defined(CONFIG_BLE_UTILS_PUBLISH)
+    /*! @brief Maximum length of a published value */
+    static constexpr uint16_t PUBLISH_MAX_LEN = CONFIG_BLE_UTILS_PUBLISH_MAX_LEN;
+
+    /**
+     * @brief Publish a value from any context, including interrupts
+     * @details The value is copied into a preallocated triple buffer and sent with @ref notify
+     *          from the system work queue. Publishing never blocks or allocates, if the previous
+     *          value was not sent yet it is replaced by the newest one. <br>
+     *          Only one context (e.g. a single ISR) may publish to a characteristic.
+     *
+     * @param data Pointer to data buffer
+     * @param len Length of the data, at most @ref PUBLISH_MAX_LEN
+     * @return 0 on success, -EMSGSIZE if the value is too large
+     */
+    int publish(const void * data, const uint16_t len);
+#endif
+
+#if defined(CONFIG_BLE_UTILS_BROADCAST)
+    /**
+     * @brief Mirror the notified values in advertising service data
+     * @details Every value sent with @ref notify or a committed batch is also published to
+     *          the broadcaster, even when no client is connected or subscribed.
+     *
+     * @param broadcaster Broadcaster that publishes the value
+     * @param max_len Maximum length of the notified value
+     * @return 0 on success or the error from adv::Broadcaster::add
+     */
+    int enable_broadcast(adv::Broadcaster &broadcaster, uint16_t max_len);
+#endif
 private:
+    /**
+     * @brief Fill the notification parameters of a value
+     *
+     * @param params Parameters to fill
+     * @param data Pointer to data buffer
+     * @param len Length of the notification data
+     */
+    void prepare(bt_gatt_notify_params &params, const void * data, const uint16_t len);
+#if defined(CONFIG_BLE_UTILS_BROADCAST)
+    /**
+     * @brief Publish a sent value to the broadcaster, if enabled
+     *
+     * @param data Pointer to data buffer
+     * @param len Length of the value
+     */
+    void broadcast(const void * data, const uint16_t len);
+#endif
+#if defined(CONFIG_BLE_UTILS_TRACING) || defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+    /**
+     * @brief Internal callback when a notification was sent
+     *
+     * @param conn Connection the notification was sent to
+     * @param user_data UUID of the characteristic
+     */
+    static void _notify_sent(bt_conn *conn, void *user_data);
+#endif
+#if defined(CONFIG_BLE_UTILS_PUBLISH)
+    /**
+     * @brief Work item with context, keeps CONTAINER_OF on a standard layout type
+     */
+    struct PublishWork
+    {
+        k_work_delayable work;
+        CharacteristicNotify *chrc;
+    };
+
+    static void _publish_handler(k_work *work);
+
+    /*! Published values, owned by the publisher (back), the work queue (front) or shared (middle) */
+    uint8_t m_pub_buf[3][PUBLISH_MAX_LEN];
+    uint16_t m_pub_len[3]{};
+    /*! Index of the shared buffer and a flag if it holds a new value */
+    atomic_t m_pub_state{ATOMIC_INIT(0)};
+    uint8_t m_pub_back{1};
+    uint8_t m_pub_front{2};
+    /*! The front buffer still has to be sent */
+    bool m_pub_pending{false};
+    PublishWork m_pub_work;
+#endif
+#if defined(CONFIG_BLE_UTILS_BROADCAST)
+    /*! Broadcaster that mirrors the notified values, nullptr if disabled */
+    adv::Broadcaster *m_broadcaster{nullptr};
+    uint8_t m_broadcast_slot{0};
+#endif
     friend Service;
 };
 
@@ -269,8 +462,28 @@ private:
      * @param params Indication params object.
      */
     static void _indicate_rsp(struct bt_gatt_indicate_params *params);
+#if defined(CONFIG_BLE_UTILS_TRACING) || defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+    /**
+     * @brief Internal callback for the confirmation of each connection
+     *
+     * @param conn Connection that confirmed the indication
+     * @param params Indication params object.
+     * @param err ATT error of the indication, 0 on success
+     */
+    static void _indicate_confirm(bt_conn *conn, bt_gatt_indicate_params *params, uint8_t err);
+#endif
+#if defined(CONFIG_BLE_UTILS_TRACING)
+    /*! Trace sequence number of the pending indication */
+    uint16_t m_trace_seq{0};
+#endif
     /*! Internal Indication parameters for @ref indicate*/
     bt_gatt_indicate_params indicate_params;
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+    /*! Indication parameters of every connection, the CCC table indicates each one */
+    bt_gatt_indicate_params m_conn_params[CONFIG_BT_MAX_CONN];
+    /*! Confirmations and the sender reference that are pending */
+    atomic_t m_ind_pending{ATOMIC_INIT(0)};
+#endif
     friend Service;
 };
 
@@ -283,20 +496,60 @@ public:
      * @param service_uuid UUID assigned to the service
      */
     Service(const bt_uuid *service_uuid);
+
+    /**
+     * @brief Construct a BLE Service with a fixed handle range
+     * @details The service declaration gets @p start_handle and all its attributes must fit
+     *          into the range, so services added in a new firmware do not shift the handles
+     *          cached by bonded clients. Keep room in the range for future characteristics.
+     *          The whole range is reserved: once a service with a range is initialized, services
+     *          without one get the handles above the highest registered service. Initialize the
+     *          services with a range first, and register other services of the application
+     *          with the zephyr api before them, otherwise their handles can conflict.
+     *
+     * @param service_uuid UUID assigned to the service
+     * @param start_handle First handle of the range, 0 to let zephyr assign the handles
+     * @param end_handle Last handle of the range
+     */
+    Service(const bt_uuid *service_uuid, uint16_t start_handle, uint16_t end_handle);
     
     /**
      * @brief Register a characteristic to the service
-     * @details should be called before @ref init
+     * @details should be called before @ref init. A characteristic that does not fit into
+     *          CONFIG_BLE_UTILS_MAX_ATTR is not registered and @ref init fails.
      * 
      * @param chrc Pointer to characteristic object
      */
     void register_char(const Characteristic * chrc);
 
+    /**
+     * @brief Include another service, e.g. a shared @ref SecondaryService
+     * @details Adds an include definition, so the attributes of @p svc are defined once and
+     *          referenced from several services. Must be called before @ref register_char.
+     *          The included service must be initialized before a client reads the include.
+     *
+     * @param svc Service to include
+     */
+    void include(Service & svc);
+
+    /**
+     * @brief Register a characteristic with a fixed handle
+     * @details The characteristic declaration gets @p handle, its value and CCC
+     *          the following handles. Handles must increase in registration order.
+     *
+     * @param chrc Pointer to characteristic object
+     * @param handle Handle of the characteristic declaration
+     */
+    void register_char(const Characteristic * chrc, uint16_t handle);
+
     /**
      * @brief Initialize the BLE Service
      * @details should be called only after registering all the characteristics for the service
      *          with @ref register_char
-     * @return Zephyr return value from bt_gatt_service_register 
+     * @return Zephyr return value from bt_gatt_service_register, -ENOMEM if the registered
+     *         attributes exceed CONFIG_BLE_UTILS_MAX_ATTR, -ENOSPC if the attributes
+     *         do not fit into the handle range, -EINVAL if the fixed handles do not increase
+     *         or -EADDRINUSE if the range overlaps with the range of another service
      */
     int init();
 
@@ -307,6 +560,48 @@ public:
     */
     const bt_uuid * get_uuid();
 
+#if defined(CONFIG_BLE_UTILS_NOTIFY_BATCH)
+    /**
+     * @brief Start collecting notifications for @ref commit
+     */
+    void begin_batch();
+
+    /**
+     * @brief Add a notification to the batch
+     * @details The data is not copied and must be valid until @ref commit returns.
+     *
+     * @param chrc Notify characteristic of the service
+     * @param data Pointer to data buffer
+     * @param len Length of the notification data
+     * @return 0 on success, -ENOMEM if the batch is full or -EINVAL if the
+     *         characteristic is not registered
+     */
+    int batch_notify(CharacteristicNotify & chrc, const void * data, const uint16_t len);
+
+    /**
+     * @brief Send the collected notifications
+     * @details The values a connection subscribed to are sent to it. With
+     *          CONFIG_BT_GATT_NOTIFY_MULTIPLE two or more values are sent as one ATT Multiple
+     *          Handle Value Notification to peers that support it, otherwise as single
+     *          notifications. A failed send does not stop the remaining ones.
+     *
+     * @return 0 on success, the first error of the internal bt api or -ENOTCONN if no
+     *         connection is subscribed
+     */
+    int commit();
+#endif
+
+protected:
+    /**
+     * @brief Construct a primary or secondary service
+     *
+     * @param service_uuid UUID assigned to the service
+     * @param start_handle First handle of the range, 0 to let zephyr assign the handles
+     * @param end_handle Last handle of the range
+     * @param primary Primary or secondary service declaration
+     */
+    Service(const bt_uuid *service_uuid, uint16_t start_handle, uint16_t end_handle, bool primary);
+
 private:
     static constexpr uint8_t MAX_ATTR = CONFIG_BLE_UTILS_MAX_ATTR;
 
@@ -316,8 +611,36 @@ private:
      */
     static constexpr uint8_t SVC_ATTR_SIZE = 1;
 
+    /**
+     * @brief Assign the handles of the attributes within the fixed range
+     *
+     * @return 0 on success or a negative error code (see @ref init)
+     */
+    int assign_handles();
+
     bt_gatt_attr attrs[MAX_ATTR];
 
+    /*! Fixed handle range, 0 if the handles are assigned by zephyr */
+    const uint16_t m_start_handle;
+    const uint16_t m_end_handle;
+    /*! Next registered service with a fixed handle range */
+    Service *m_next_pinned{nullptr};
+    /*! Number of include definitions */
+    uint8_t m_include_cnt{0};
+    /*! An attribute did not fit into @ref attrs */
+    bool m_attr_overflow{false};
+#if defined(CONFIG_BLE_UTILS_NOTIFY_BATCH)
+    static constexpr uint16_t BATCH_MAX = CONFIG_BLE_UTILS_NOTIFY_BATCH_MAX;
+    bt_gatt_notify_params m_batch[BATCH_MAX];
+    /*! Notifications of the batch that are sent to a connection */
+    bt_gatt_notify_params m_batch_conn[BATCH_MAX];
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+    /*! CCC table index of every batched notification */
+    uint16_t m_batch_ccc[BATCH_MAX];
+#endif
+    uint16_t m_batch_cnt{0};
+#endif
+
     /**
      * @brief Zephyr struct with BLE Gatt service data
      * @details This struct is changed at run-time when 
@@ -326,6 +649,35 @@ private:
      * 
      */
     bt_gatt_service m_gatt_service;
+#if defined(CONFIG_BLE_UTILS_SNAPSHOT)
+    friend Snapshot;
+#endif
+};
+
+/**
+ * @brief Secondary service
+ * @details A secondary service is only discovered through the services that include it
+ *          (see @ref Service::include). It is used to share a block of characteristics
+ *          between several primary services without duplicating its attributes.
+ */
+class SecondaryService : public Service
+{
+public:
+    /**
+     * @brief Construct a secondary BLE Service
+     *
+     * @param service_uuid UUID assigned to the service
+     */
+    SecondaryService(const bt_uuid *service_uuid);
+
+    /**
+     * @brief Construct a secondary BLE Service with a fixed handle range
+     *
+     * @param service_uuid UUID assigned to the service
+     * @param start_handle First handle of the range
+     * @param end_handle Last handle of the range
+     */
+    SecondaryService(const bt_uuid *service_uuid, uint16_t start_handle, uint16_t end_handle);
 };
 
 }
@@ -0,0 +1,136 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file broadcast.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Connectionless mirror of characteristic values in extended or
+* periodic advertising service data.
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/kernel.h>
+
+namespace ble_utils::adv
+{
+
+/**
+ * @brief Publishes the latest value of several characteristics as service data
+ *        of an extended or periodic advertising set.
+ *
+ * @details Each registered slot is encoded as one service data AD element:
+ *          | UUID (2, 4 or 16 bytes) | version (uint16 LE) | value |
+ *          The version is incremented on every @ref publish, so scanners can detect
+ *          new and coalesced values. Updates of the advertising data are rate limited,
+ *          publishing faster than the minimum interval only keeps the latest value. <br>
+ *          The advertising set is created and started by the application, which keeps
+ *          control of the advertising parameters.
+ */
+class Broadcaster
+{
+public:
+    /**
+     * @brief Advertising data that carries the service data
+     */
+    enum class Mode
+    {
+        Extended,   /*!< Data of an extended advertising set (bt_le_ext_adv_set_data) */
+        Periodic    /*!< Periodic advertising data (bt_le_per_adv_set_data) */
+    };
+
+    /*! @brief Size of the version counter in the service data */
+    static constexpr uint8_t VERSION_SIZE{2U};
+    /*! @brief Maximum data length of an AD element, the length field includes the type */
+    static constexpr uint16_t MAX_AD_DATA_LEN{254U};
+
+    /**
+     * @brief Construct a Broadcaster
+     *
+     * @param mode Advertising data that is updated
+     * @param min_interval_ms Minimum time between two advertising data updates
+     */
+    Broadcaster(Mode mode, uint32_t min_interval_ms);
+
+    /**
+     * @brief Initialize the broadcaster with the advertising set of the application
+     * @details For @ref Mode::Periodic the set must be configured with
+     *          bt_le_per_adv_set_param. <br>
+     *          For @ref Mode::Extended every update replaces the advertising data of
+     *          the set, the AD elements of the application (e.g. flags and name) are
+     *          passed here and advertised before the service data. The elements are
+     *          copied, the data they point to must stay valid.
+     *
+     * @param adv Advertising set that carries the data
+     * @param ad AD elements of the application, only used with @ref Mode::Extended
+     * @param ad_len Number of AD elements, up to CONFIG_BLE_UTILS_BROADCAST_MAX_APP_AD
+     * @return 0 on success, -EINVAL for an invalid set, -ENOTSUP if periodic
+     *         advertising is not enabled, -ENOMEM if there are too many AD elements
+     */
+    int init(bt_le_ext_adv *adv, const bt_data *ad = nullptr, size_t ad_len = 0);
+
+    /**
+     * @brief Register a value slot
+     * @details should be called before @ref init
+     *
+     * @param uuid UUID that identifies the value in the service data
+     * @param max_len Maximum length of the value
+     * @return Slot id on success, -ENOMEM if no slot or data is left,
+     *         -EINVAL for an unsupported UUID type, -EMSGSIZE if the UUID, version
+     *         and value exceed the length of an AD element
+     */
+    int add(const bt_uuid *uuid, uint16_t max_len);
+
+    /**
+     * @brief Publish a new value for a slot
+     * @details The advertising data is updated from the system work queue once
+     *          the minimum interval since the last update has elapsed.
+     *
+     * @param slot Slot id returned by @ref add
+     * @param data Pointer to the value
+     * @param len Length of the value
+     * @return 0 on success, -EINVAL for an unknown slot, -EMSGSIZE if the value is too large
+     */
+    int publish(uint8_t slot, const void *data, uint16_t len);
+
+private:
+    static constexpr uint8_t MAX_SLOTS = CONFIG_BLE_UTILS_BROADCAST_MAX_SLOTS;
+    static constexpr uint16_t DATA_SIZE = CONFIG_BLE_UTILS_BROADCAST_DATA_SIZE;
+    static constexpr uint8_t MAX_APP_AD = CONFIG_BLE_UTILS_BROADCAST_MAX_APP_AD;
+
+    /**
+     * @brief Service data of a registered value
+     */
+    struct Slot
+    {
+        uint8_t *buf;       /*!< Encoded service data */
+        uint8_t hdr_len;    /*!< UUID and version length */
+        uint16_t max_len;   /*!< Maximum value length */
+        uint16_t version;   /*!< Version counter */
+    };
+
+    static void update_work_handler(k_work *work);
+
+    const Mode m_mode;
+    const uint32_t m_min_interval_ms;
+    bt_le_ext_adv *m_adv{nullptr};
+    Slot m_slots[MAX_SLOTS];
+    /*! Application AD elements, aligned to the end of their part, then the service data */
+    bt_data m_ad[MAX_APP_AD + MAX_SLOTS];
+    uint8_t m_app_ad_cnt{0};
+    uint8_t m_slot_cnt{0};
+    uint8_t m_data[DATA_SIZE];
+    uint16_t m_data_used{0};
+    int64_t m_last_update{0};
+    k_mutex m_lock;
+    k_work_delayable m_work;
+};
+
+} // namespace ble_utils::adv
@@ -0,0 +1,160 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file bulk.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* LE credit based L2CAP channel for bulk transfers next to a GATT
+* service, with its PSM published in a characteristic.
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <ble_utils/ble_utils.hpp>
+#include <zephyr/bluetooth/l2cap.h>
+
+namespace ble_utils::gatt
+{
+
+class BulkChannel;
+
+/**
+ * @brief Read only characteristic with the PSM of a @ref BulkChannel (u16 little endian)
+ */
+class PsmCharacteristic : public Characteristic
+{
+public:
+    PsmCharacteristic(const bt_uuid * uuid, const BulkChannel &channel);
+
+    ssize_t read_cb(void *buf, uint16_t len, uint16_t offset) override;
+
+private:
+    const BulkChannel &m_channel;
+};
+
+/**
+ * @brief Bulk transfer channel of a service
+ * @details An LE credit based L2CAP server with one channel per connection. Data is sent
+ *          and received as SDUs of up to CONFIG_BLE_UTILS_BULK_SDU_SIZE bytes from buffer
+ *          pools shared by all bulk channels, while control stays on GATT. <br>
+ *          Send buffers return to the pool once the peer granted the credits to transmit
+ *          them, so @ref send fails with -ENOMEM instead of blocking when the peer is slow.
+ *          The credits of a received SDU are returned to the peer after @ref recv_cb. <br>
+ *          Example: <br>
+ *          class Logs : public ble_utils::gatt::BulkChannel { ... }; <br>
+ *          Logs logs; <br>
+ *          ble_utils::gatt::PsmCharacteristic logs_psm(&uuid::logs_psm, logs); <br>
+ *          service.register_char(&logs_psm); <br>
+ *          logs.init();
+ */
+class BulkChannel
+{
+public:
+    /**
+     * @brief Construct a bulk channel
+     *
+     * @param psm L2CAP PSM or 0 to allocate a dynamic PSM on @ref init
+     * @param sec_level Required security level of the channel
+     */
+    explicit BulkChannel(uint16_t psm = 0, bt_security_t sec_level = BT_SECURITY_L1);
+
+    BulkChannel(const BulkChannel &) = delete;
+    BulkChannel & operator=(const BulkChannel &) = delete;
+
+    /**
+     * @brief Register the L2CAP server
+     * @details The receive pool must hold one SDU per bulk channel and connection
+     *          (CONFIG_BLE_UTILS_BULK_RX_BUF_CNT).
+     *
+     * @return -ENOMEM if the receive pool is too small for another channel,
+     *         otherwise the Zephyr return value from bt_l2cap_server_register
+     */
+    int init();
+
+    /**
+     * @brief Get the PSM of the channel
+     *
+     * @return PSM, valid after @ref init
+     */
+    uint16_t get_psm() const;
+
+    /**
+     * @brief Send a SDU to a connection
+     *
+     * @param conn Connection object
+     * @param data Pointer to data buffer
+     * @param len Length of the data
+     * @return 0 on success, -ENOTCONN if the connection has no open channel, -EMSGSIZE if
+     *         the data exceeds the SDU size of either side, -ENOMEM if no send buffer is
+     *         available or the zephyr error of bt_l2cap_chan_send
+     */
+    int send(bt_conn *conn, const void *data, uint16_t len);
+
+    /**
+     * @brief Callback for a received SDU
+     *
+     * @param conn Connection that sent the data
+     * @param data Received data
+     * @param len Length of the data
+     */
+    virtual void recv_cb(bt_conn *conn, const void *data, uint16_t len) = 0;
+
+    /**
+     * @brief Callback when a SDU was sent
+     *
+     * @param conn Connection object
+     */
+    virtual void sent_cb(bt_conn *conn)
+    {
+        ARG_UNUSED(conn);
+    }
+
+    /**
+     * @brief Callback when a peer opened or closed the channel
+     *
+     * @param conn Connection object
+     * @param connected true if the channel was opened
+     */
+    virtual void channel_changed(bt_conn *conn, bool connected)
+    {
+        ARG_UNUSED(conn);
+        ARG_UNUSED(connected);
+    }
+
+private:
+    /**
+     * @brief Server with context, keeps CONTAINER_OF on a standard layout type
+     */
+    struct Server
+    {
+        bt_l2cap_server server;
+        BulkChannel *self;
+    };
+
+    /**
+     * @brief Channel of a connection, keeps CONTAINER_OF on a standard layout type
+     */
+    struct Chan
+    {
+        bt_l2cap_le_chan le;
+        BulkChannel *self;
+        bool connected;
+    };
+
+    static int _accept(bt_conn *conn, bt_l2cap_server *server, bt_l2cap_chan **chan);
+    static void _connected(bt_l2cap_chan *chan);
+    static void _disconnected(bt_l2cap_chan *chan);
+    static net_buf * _alloc_buf(bt_l2cap_chan *chan);
+    static int _recv(bt_l2cap_chan *chan, net_buf *buf);
+    static void _sent(bt_l2cap_chan *chan);
+
+    Server m_server;
+    Chan m_chans[CONFIG_BT_MAX_CONN];
+};
+
+} // namespace ble_utils::gatt
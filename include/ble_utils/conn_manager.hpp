@@ -0,0 +1,206 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file conn_manager.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Central connection manager that scans, connects, discovers and
+* subscribes to several peripherals concurrently.
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <ble_utils/scanner.hpp>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ble_utils::client
+{
+
+/**
+ * @brief Connection manager for a central with up to CONFIG_BT_MAX_CONN peripherals
+ * @details Every link runs its own state machine: <br>
+ *          Idle -> Connecting -> Discovering -> Subscribing -> Ready <br>
+ *          Devices that match the filter are connected one at a time, as the controller has
+ *          a single initiator. Scanning is resumed as soon as the initiator is free, so the
+ *          discovery of established links runs in parallel with new connections. With
+ *          CONFIG_BT_SCAN_AND_INITIATE_IN_PARALLEL scanning continues while connecting. <br>
+ *          The discovery finds the service of the manager and reports its characteristics
+ *          with @ref characteristic_found. Only one manager can be active.
+ */
+class ConnManager : private scan::Scanner
+{
+public:
+    /**
+     * @brief State of a link
+     */
+    enum class State : uint8_t
+    {
+        Idle,           /*!< Link slot is free */
+        Connecting,     /*!< Connection is being created */
+        Discovering,    /*!< Service and characteristics are discovered */
+        Subscribing,    /*!< Application subscribes (see @ref subscribe) */
+        Ready           /*!< Link is ready */
+    };
+
+    /*! @brief Number of link states */
+    static constexpr size_t STATE_CNT{static_cast<size_t>(State::Ready) + 1U};
+
+    /**
+     * @brief Duration of a stage over all the links
+     */
+    struct StageStats
+    {
+        uint32_t samples;   /*!< Links that completed the stage */
+        uint32_t total_ms;  /*!< Sum of the durations */
+        uint32_t max_ms;    /*!< Longest duration */
+    };
+
+    /**
+     * @brief Construct a connection manager
+     *
+     * @param filter Advertised service UUIDs to connect to (see scan::UuidFilter)
+     * @param svc_uuid UUID of the primary service to discover
+     * @param scan_param Zephyr scan parameters
+     * @param create_param Zephyr connection create parameters
+     * @param conn_param Zephyr connection parameters
+     */
+    ConnManager(const scan::FilterTable &filter,
+                const bt_uuid *svc_uuid,
+                const bt_le_scan_param &scan_param,
+                const bt_conn_le_create_param &create_param,
+                const bt_le_conn_param &conn_param);
+
+    ConnManager(const ConnManager &) = delete;
+    ConnManager & operator=(const ConnManager &) = delete;
+
+    /**
+     * @brief Start scanning and connecting
+     *
+     * @return 0 on success or the zephyr error of bt_le_scan_start
+     */
+    int start();
+
+    /**
+     * @brief Complete the subscribing stage of a link
+     * @details Only needed if @ref subscribe returned -EINPROGRESS.
+     *
+     * @param conn Connection object
+     * @param err 0 if the subscriptions succeeded, otherwise the link is disconnected
+     */
+    void subscribe_done(bt_conn *conn, int err);
+
+    /**
+     * @brief Number of links in a state
+     *
+     * @param state Link state, State::Idle returns the free link slots
+     * @return Number of links
+     */
+    uint8_t count(State state) const;
+
+    /**
+     * @brief Duration statistics of a stage
+     *
+     * @param state Connecting, Discovering or Subscribing
+     * @return Statistics of the stage
+     */
+    const StageStats & stage(State state) const;
+
+protected:
+    /**
+     * @brief Callback for a discovered characteristic of the service
+     *
+     * @param conn Connection object
+     * @param attr Characteristic declaration, the value handle follows it
+     * @param chrc Characteristic properties and UUID
+     */
+    virtual void characteristic_found(bt_conn *conn, const bt_gatt_attr *attr,
+                                      const bt_gatt_chrc *chrc)
+    {
+        ARG_UNUSED(conn);
+        ARG_UNUSED(attr);
+        ARG_UNUSED(chrc);
+    }
+
+    /**
+     * @brief Subscribing stage of a link
+     *
+     * @param conn Connection object
+     * @return 0 if the link is ready, -EINPROGRESS if @ref subscribe_done is called
+     *         later or a negative error to disconnect the link
+     */
+    virtual int subscribe(bt_conn *conn)
+    {
+        ARG_UNUSED(conn);
+        return 0;
+    }
+
+    /**
+     * @brief Callback when a link is ready
+     *
+     * @param conn Connection object
+     */
+    virtual void ready(bt_conn *conn)
+    {
+        ARG_UNUSED(conn);
+    }
+
+    /**
+     * @brief Callback when a link was disconnected
+     *
+     * @param conn Connection object
+     * @param reason HCI reason for the disconnection
+     */
+    virtual void disconnected(bt_conn *conn, uint8_t reason)
+    {
+        ARG_UNUSED(conn);
+        ARG_UNUSED(reason);
+    }
+
+private:
+    /**
+     * @brief Link slot, keeps CONTAINER_OF on a standard layout type
+     */
+    struct Link
+    {
+        bt_gatt_discover_params params;
+        ConnManager *self;
+        bt_conn *conn;
+        State state;
+        int64_t stage_start;
+    };
+
+    void device_found(const bt_le_scan_recv_info *info, net_buf_simple *ad) override;
+    static void _connected(bt_conn *conn, uint8_t err);
+    static void _disconnected(bt_conn *conn, uint8_t reason);
+    static uint8_t _discover_cb(bt_conn *conn, const bt_gatt_attr *attr,
+                                bt_gatt_discover_params *params);
+    uint8_t discover_cb(Link &link, const bt_gatt_attr *attr);
+    void connected(Link &link, uint8_t err);
+    void subscribing(Link &link);
+    void enter(Link &link, State state);
+    void release(Link &link);
+    void fail(Link &link);
+    void resume_scan();
+    Link * find(const bt_conn *conn);
+    Link * find_free();
+
+    const bt_uuid *m_svc_uuid;
+    const bt_le_scan_param m_scan_param;
+    const bt_conn_le_create_param m_create_param;
+    const bt_le_conn_param m_conn_param;
+    bool m_scanning{false};
+    /*! A connection is being created, the initiator is busy */
+    bool m_initiating{false};
+    Link m_links[CONFIG_BT_MAX_CONN];
+    StageStats m_stats[STATE_CNT];
+};
+
+} // namespace ble_utils::client
@@ -0,0 +1,292 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file conn_tuning.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Connection tuning that applies a throughput or latency profile
+* to every new BLE connection and reports the negotiated link parameters.
+* Optionally the connection parameters follow the notification and
+* indication backlog of the library (CONFIG_BLE_UTILS_CONN_ADAPTIVE).
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gap.h>
+
+namespace ble_utils::conn
+{
+
+/**
+ * @brief Link parameters negotiated for a connection
+ */
+struct LinkParams
+{
+    /*! @brief ATT header size of a notification/write without response (opcode + handle) */
+    static constexpr uint16_t ATT_HDR_SIZE{3U};
+    uint16_t att_mtu;       /*!< ATT MTU agreed by both peers */
+    uint16_t tx_max_len;    /*!< Max. LL payload octets sent by this device */
+    uint16_t rx_max_len;    /*!< Max. LL payload octets received by this device */
+    uint8_t tx_phy;         /*!< TX PHY (BT_GAP_LE_PHY_*) */
+    uint8_t rx_phy;         /*!< RX PHY (BT_GAP_LE_PHY_*) */
+    uint16_t interval;      /*!< Connection interval in units of 1.25 ms */
+    uint16_t latency;       /*!< Peripheral latency in connection events */
+    uint16_t timeout;       /*!< Supervision timeout in units of 10 ms */
+
+    /**
+     * @brief Maximum value length that fits in a single notification or
+     *        write without response.
+     */
+    constexpr uint16_t att_payload() const
+    {
+        return att_mtu - ATT_HDR_SIZE;
+    }
+};
+
+/**
+ * @brief Connection profile that is requested on connect
+ * @details Each procedure is requested independently, the peer or controller
+ *          can reject or modify any of them. The result is reported through
+ *          @ref ILinkListener.
+ */
+struct Profile
+{
+    bool exchange_mtu;                      /*!< Run the ATT MTU exchange (requires CONFIG_BT_GATT_CLIENT) */
+    bt_conn_le_data_len_param data_len;     /*!< LE Data Length Extension request */
+    bt_conn_le_phy_param phy;               /*!< PHY update request */
+    bt_le_conn_param conn_param;            /*!< Connection parameter request */
+};
+
+namespace profile
+{
+/*! @brief Maximum MTU, data length and 2M PHY with a moderate connection interval */
+static constexpr Profile throughput
+{
+    .exchange_mtu = true,
+    .data_len = {
+        .tx_max_len = BT_GAP_DATA_LEN_MAX,
+        .tx_max_time = BT_GAP_DATA_TIME_MAX
+    },
+    .phy = {
+        .options = BT_CONN_LE_PHY_OPT_NONE,
+        .pref_tx_phy = BT_GAP_LE_PHY_2M,
+        .pref_rx_phy = BT_GAP_LE_PHY_2M
+    },
+    .conn_param = {
+        .interval_min = 24,     /* 30 ms */
+        .interval_max = 40,     /* 50 ms */
+        .latency = 0,
+        .timeout = 400          /* 4 s */
+    }
+};
+
+/*! @brief Shortest connection interval without peripheral latency on 2M PHY */
+static constexpr Profile low_latency
+{
+    .exchange_mtu = true,
+    .data_len = {
+        .tx_max_len = BT_GAP_DATA_LEN_DEFAULT,
+        .tx_max_time = BT_GAP_DATA_TIME_DEFAULT
+    },
+    .phy = {
+        .options = BT_CONN_LE_PHY_OPT_NONE,
+        .pref_tx_phy = BT_GAP_LE_PHY_2M,
+        .pref_rx_phy = BT_GAP_LE_PHY_2M
+    },
+    .conn_param = {
+        .interval_min = 6,      /* 7.5 ms */
+        .interval_max = 12,     /* 15 ms */
+        .latency = 0,
+        .timeout = 400          /* 4 s */
+    }
+};
+} // namespace profile
+
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+namespace adaptive
+{
+
+/**
+ * @brief Connection parameters requested by the adaptive controller
+ */
+enum class Mode : uint8_t
+{
+    None,       /*!< Nothing requested yet, the profile parameters apply */
+    Active,     /*!< Data is queued, short interval without latency */
+    Idle        /*!< No data, long interval with peripheral latency */
+};
+
+/**
+ * @brief Policy of the adaptive connection parameters
+ * @details The active parameters are requested as soon as the backlog or the send rate reach
+ *          their thresholds. The idle parameters are requested only after the link was idle,
+ *          no backlog and a send rate below @ref idle_rate, for @ref idle_hold_ms. The gap
+ *          between both thresholds and the hold time keep the link from flapping.
+ */
+struct Policy
+{
+    bt_le_conn_param active;    /*!< Parameters requested while data is queued */
+    bt_le_conn_param idle;      /*!< Parameters requested when idle */
+    uint16_t active_backlog;    /*!< Pending sends that switch to the active parameters */
+    uint16_t active_rate;       /*!< Sends per second that switch to the active parameters */
+    uint16_t idle_rate;         /*!< Sends per second below which the link can be idle */
+    uint16_t idle_hold_ms;      /*!< Idle time before the idle parameters are requested */
+};
+
+namespace policy
+{
+/*! @brief 7.5-15 ms while sending, 100-200 ms with a latency of 4 events after 2 s idle */
+static constexpr Policy balanced
+{
+    .active = {
+        .interval_min = 6,      /* 7.5 ms */
+        .interval_max = 12,     /* 15 ms */
+        .latency = 0,
+        .timeout = 400          /* 4 s */
+    },
+    .idle = {
+        .interval_min = 80,     /* 100 ms */
+        .interval_max = 160,    /* 200 ms */
+        .latency = 4,
+        .timeout = 400          /* 4 s */
+    },
+    .active_backlog = 2,
+    .active_rate = 20,
+    .idle_rate = 5,
+    .idle_hold_ms = 2000
+};
+} // namespace policy
+
+/**
+ * @brief Sample of the adaptive controller
+ */
+struct Sample
+{
+    uint32_t timestamp_ms;  /*!< Uptime of the sample */
+    uint16_t backlog;       /*!< Sends to the connection accepted by the host that did not complete */
+    uint16_t send_rate;     /*!< Notifications and indications per second */
+    uint32_t byte_rate;     /*!< Bytes per second */
+    Mode mode;              /*!< Mode after the sample */
+};
+
+/**
+ * @brief Statistics of the adaptive controller
+ */
+struct Stats
+{
+    uint32_t to_active;     /*!< Switches of a connection to the active parameters */
+    uint32_t to_idle;       /*!< Switches of a connection to the idle parameters */
+    uint32_t req_failed;    /*!< Parameter requests the host did not accept */
+    uint32_t active_ms;     /*!< Time the connections spent in the active mode, summed */
+    Sample last;            /*!< Last sample of any connection */
+};
+
+} // namespace adaptive
+#endif
+
+/**
+ * @brief Interface to receive the negotiated link parameters
+ * @details Characteristics can implement this interface to size their payloads
+ *          according to the ATT MTU and data length of a connection.
+ */
+class ILinkListener
+{
+public:
+    /**
+     * @brief Callback when any of the link parameters of a connection changed
+     *
+     * @param conn Connection whose parameters changed
+     * @param params Current link parameters of the connection
+     */
+    virtual void link_updated(bt_conn *conn, const LinkParams &params) = 0;
+
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+    /**
+     * @brief Callback when the adaptive controller requested connection parameters
+     * @details The negotiated parameters follow with @ref link_updated.
+     *
+     * @param conn Connection the parameters were requested for
+     * @param param Requested connection parameters
+     * @param sample Sample that caused the request
+     */
+    virtual void params_requested(bt_conn *conn, const bt_le_conn_param &param,
+                                  const adaptive::Sample &sample)
+    {
+        ARG_UNUSED(conn);
+        ARG_UNUSED(param);
+        ARG_UNUSED(sample);
+    }
+#endif
+
+    virtual ~ILinkListener() = default;
+};
+
+/**
+ * @brief Initialize the connection tuning
+ * @details Registers the connection callbacks. The profile is applied to every connection
+ *          established afterwards. Should be called before advertising or scanning.
+ *
+ * @param profile Profile applied to new connections
+ * @return 0 on success, -EALREADY if already initialized
+ */
+int init(const Profile &profile);
+
+/**
+ * @brief Register a listener for link parameter updates
+ * @details At most CONFIG_BLE_UTILS_CONN_TUNING_MAX_LISTENERS can be registered.
+ *
+ * @param listener Pointer to the listener object
+ */
+void register_listener(ILinkListener *listener);
+
+/**
+ * @brief Get the current link parameters of a connection
+ *
+ * @param conn Connection object
+ * @param params Output parameters
+ * @return 0 on success, -ENOTCONN if the connection is not tracked
+ */
+int get_params(const bt_conn *conn, LinkParams &params);
+
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+namespace adaptive
+{
+
+/**
+ * @brief Start the adaptive connection parameters
+ * @details Every CONFIG_BLE_UTILS_CONN_ADAPTIVE_SAMPLE_MS the backlog and the send rate of the
+ *          notifications and indications of the library are sampled per connection and the
+ *          parameters of the policy are requested for a connection when its mode changes.
+ *          New connections start with the profile parameters. The sampling pauses while there
+ *          is no connection. Each request is logged, traced with CONFIG_BLE_UTILS_TRACING and
+ *          reported to ILinkListener::params_requested.
+ *
+ * @param policy Policy of the controller
+ * @return 0 on success, -EPERM if the connection tuning is not initialized,
+ *         -EALREADY if already started
+ */
+int start(const Policy &policy);
+
+/**
+ * @brief Stop the adaptive connection parameters
+ * @details The last requested parameters stay in place.
+ */
+void stop();
+
+/**
+ * @brief Get the statistics of the adaptive controller
+ *
+ * @param stats Output statistics
+ */
+void get_stats(Stats &stats);
+
+} // namespace adaptive
+#endif
+
+} // namespace ble_utils::conn
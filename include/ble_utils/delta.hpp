@@ -0,0 +1,209 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file delta.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Delta encoded notifications for large structured values and the
+* matching client side decoder.
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <ble_utils/ble_utils.hpp>
+#if defined(CONFIG_BLE_UTILS_DELTA)
+#include <ble_utils/session.hpp>
+#endif
+#include <errno.h>
+#include <string.h>
+
+namespace ble_utils::gatt
+{
+
+/**
+ * @brief Frame format of delta encoded notifications
+ * @details Every frame starts with | flags (u8) | sequence (u8) |. <br>
+ *          Keyframe: | header | value | <br>
+ *          Delta: | header | offset (u8) | length (u8) | bytes | ... | <br>
+ *          The sequence is incremented per frame of a connection, so a client detects
+ *          a lost frame and waits for the next keyframe.
+ */
+namespace delta
+{
+/*! @brief Frame header size */
+static constexpr uint8_t HDR_SIZE{2U};
+/*! @brief Header of a changed range: offset and length */
+static constexpr uint8_t RANGE_HDR_SIZE{2U};
+/*! @brief Frame carries the complete value */
+static constexpr uint8_t FLAG_KEYFRAME{BIT(0)};
+/*! @brief Largest value that can be delta encoded, offsets are 8 bit */
+static constexpr uint16_t MAX_VALUE_LEN{UINT8_MAX};
+
+/**
+ * @brief Client side decoder of delta encoded notifications
+ * @details Example for the notify callback of a central: <br>
+ *          static ble_utils::gatt::delta::Decoder<200> decoder; <br>
+ *          if (decoder.apply(data, length) == 0) { use(decoder.value(), decoder.len()); }
+ *
+ * @tparam MaxLen Maximum length of the value
+ */
+template<uint16_t MaxLen>
+class Decoder
+{
+    static_assert(MaxLen <= MAX_VALUE_LEN, "Value too large for delta encoding");
+public:
+    /**
+     * @brief Apply a received frame to the value
+     *
+     * @param frame Notification data
+     * @param frame_len Notification length
+     * @return 0 if the value was updated, -EAGAIN if a frame was lost and
+     *         the decoder waits for a keyframe, -EINVAL if the frame is malformed
+     */
+    int apply(const void *frame, uint16_t frame_len)
+    {
+        const uint8_t *buf = static_cast<const uint8_t *>(frame);
+        if (frame_len < HDR_SIZE) {
+            return -EINVAL;
+        }
+        const uint8_t flags = buf[0];
+        const uint8_t seq = buf[1];
+        const uint8_t *body = &buf[HDR_SIZE];
+        const uint16_t body_len = frame_len - HDR_SIZE;
+        if (flags & FLAG_KEYFRAME) {
+            if (body_len > MaxLen) {
+                return -EINVAL;
+            }
+            memcpy(m_value, body, body_len);
+            m_len = body_len;
+            m_seq = seq;
+            m_synced = true;
+            return 0;
+        }
+        if (!m_synced || seq != static_cast<uint8_t>(m_seq + 1U)) {
+            m_synced = false;
+            return -EAGAIN;
+        }
+        /* Validate all the ranges before the value is modified */
+        for (uint16_t pos = 0; pos < body_len;) {
+            if (body_len - pos < RANGE_HDR_SIZE ||
+                body[pos] + body[pos + 1] > m_len ||
+                body_len - pos - RANGE_HDR_SIZE < body[pos + 1]) {
+                return -EINVAL;
+            }
+            pos += RANGE_HDR_SIZE + body[pos + 1];
+        }
+        for (uint16_t pos = 0; pos < body_len;) {
+            memcpy(&m_value[body[pos]], &body[pos + RANGE_HDR_SIZE], body[pos + 1]);
+            pos += RANGE_HDR_SIZE + body[pos + 1];
+        }
+        m_seq = seq;
+        return 0;
+    }
+
+    /**
+     * @brief Current value, valid after the first keyframe
+     */
+    const uint8_t * value() const
+    {
+        return m_value;
+    }
+
+    /**
+     * @brief Length of the current value
+     */
+    uint16_t len() const
+    {
+        return m_len;
+    }
+
+    /**
+     * @brief Wait for a keyframe, e.g. after a reconnection
+     */
+    void reset()
+    {
+        m_synced = false;
+    }
+
+private:
+    uint8_t m_value[MaxLen]{};
+    uint16_t m_len{0};
+    uint8_t m_seq{0};
+    bool m_synced{false};
+};
+} // namespace delta
+
+#if defined(CONFIG_BLE_UTILS_DELTA)
+/**
+ * @brief Notify characteristic that only sends the changed bytes of its value
+ * @details The last value sent to every subscriber is kept, @ref notify_delta sends a frame
+ *          with the changed ranges (see @ref delta). A keyframe with the complete value is sent
+ *          to a new subscriber, after every CCC write of a connection, every
+ *          CONFIG_BLE_UTILS_DELTA_KEYFRAME_INTERVAL frames and whenever the delta would not be
+ *          smaller. The frames must fit into the ATT MTU.
+ * @note  Classes that override @ref conn_ccc_written should call
+ *        DeltaCharacteristic::conn_ccc_written.
+ */
+class DeltaCharacteristic : public CharacteristicNotify
+{
+public:
+    /*! @brief Maximum length of the value */
+    static constexpr uint16_t MAX_LEN = CONFIG_BLE_UTILS_DELTA_MAX_LEN;
+    static_assert(MAX_LEN <= delta::MAX_VALUE_LEN, "Value too large for delta encoding");
+
+    /**
+     * @brief Construct a delta notify characteristic
+     *
+     * @param uuid UUID assigned to the characteristic
+     * @param props Properties that are assigned to the characteristic.
+     * @param perm Permissions of the characteristic (see zephyr enum bt_gatt_perm)
+     */
+    DeltaCharacteristic(const bt_uuid * uuid, uint8_t props, uint8_t perm);
+    DeltaCharacteristic(const bt_uuid * uuid);
+
+    /**
+     * @brief Send the changes of the value to all the subscribers
+     *
+     * @param data Complete value
+     * @param len Length of the value, at most @ref MAX_LEN
+     * @return 0 on success, -EMSGSIZE if the value is too large or the zephyr gatt
+     *         error of the last subscriber that failed
+     */
+    int notify_delta(const void *data, uint16_t len);
+
+    void conn_ccc_written(bt_conn *conn, CCCValue_e value) override;
+
+private:
+    /**
+     * @brief Last value sent to a subscriber
+     */
+    struct Peer
+    {
+        bool synced;            /*!< The subscriber has received a keyframe */
+        uint8_t seq;
+        uint16_t since_keyframe;
+        uint16_t len;
+        uint8_t image[MAX_LEN];
+    };
+
+    static void _send(bt_conn *conn, void *user_data);
+    void send(bt_conn *conn);
+    void resync(bt_conn *conn);
+    uint16_t encode(const Peer &peer);
+
+    Sessions<Peer> m_peers;
+    /*! Registered value attribute, resolved on the first notification */
+    const bt_gatt_attr *m_attr{nullptr};
+    const uint8_t *m_data{nullptr};
+    uint16_t m_len{0};
+    int m_err{0};
+    uint8_t m_frame[delta::HDR_SIZE + MAX_LEN];
+};
+#endif
+
+} // namespace ble_utils::gatt
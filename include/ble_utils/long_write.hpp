@@ -0,0 +1,86 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file long_write.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Characteristic that reassembles prepared (long) writes in blocks of
+* a pool shared by all long writable characteristics.
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <ble_utils/ble_utils.hpp>
+#include <ble_utils/session.hpp>
+
+namespace ble_utils::gatt
+{
+
+/**
+ * @brief Characteristic with library managed long writes
+ * @details The fragments of a prepared write are collected into contiguous blocks of a pool
+ *          shared by all the long writable characteristics
+ *          (CONFIG_BLE_UTILS_LONG_WRITE_BLOCK_CNT x CONFIG_BLE_UTILS_LONG_WRITE_BLOCK_SIZE).
+ *          The blocks are held per connection only while a long write is in progress. They are
+ *          released after it executes, when the next long write of the connection starts or
+ *          when the connection is lost. zephyr does not report a cancelled long write, its
+ *          blocks are held until a prepare at offset 0 starts the next one. Gaps between
+ *          the fragments are delivered as zeros. A prepare request is rejected with
+ *          BT_ATT_ERR_PREPARE_QUEUE_FULL if the pool has no room. <br>
+ *          Single writes and executed long writes are delivered with @ref on_value_written.
+ */
+class LongWriteCharacteristic : public Characteristic, private ISessionPool
+{
+public:
+    /**
+     * @brief Construct a long writable characteristic
+     *
+     * @param uuid UUID assigned to the characteristic
+     * @param props Properties that are assigned to the characteristic.
+     *               BT_GATT_CHRC_WRITE is initialized by default.
+     * @param perm Permissions of the characteristic (see zephyr enum bt_gatt_perm)
+     *             BT_GATT_PERM_WRITE and BT_GATT_PERM_PREPARE_WRITE are initialized by default.
+     * @param max_len Maximum length of the value
+     */
+    LongWriteCharacteristic(const bt_uuid * uuid, uint8_t props, uint8_t perm, uint16_t max_len);
+
+    /**
+     * @brief Callback with the complete written value
+     *
+     * @param conn Connection that wrote the value
+     * @param data Contiguous value
+     * @param len Length of the value
+     * @return 0 to accept the value or BT_GATT_ERR() with a specific BT_ATT_ERR_* error code.
+     */
+    virtual ssize_t on_value_written(bt_conn *conn, const void *data, uint16_t len) = 0;
+
+    ssize_t conn_write_cb(bt_conn *conn, const void *buf, uint16_t len,
+                          uint16_t offset, uint8_t flags) override;
+
+private:
+    /**
+     * @brief Long write of a connection
+     */
+    struct Assembly
+    {
+        size_t block;       /*!< First pool block */
+        uint16_t len;       /*!< Written extent, bytes below it are written or zeroed */
+        bool allocated;     /*!< The pool blocks are held */
+        bool executed;      /*!< The value was delivered, remaining fragments are ignored */
+    };
+
+    void release(uint8_t conn_idx) override;
+    ssize_t prepare(Assembly &assembly, const void *buf, uint16_t len, uint16_t offset);
+    ssize_t execute(bt_conn *conn, Assembly &assembly, const void *buf, uint16_t len);
+
+    const uint16_t m_max_len;
+    const size_t m_blocks;
+    Assembly m_assembly[CONFIG_BT_MAX_CONN];
+};
+
+} // namespace ble_utils::gatt
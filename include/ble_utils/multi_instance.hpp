@@ -0,0 +1,306 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file multi_instance.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Services that are registered several times from one const template.
+* The UUIDs, properties, permissions and characteristic declarations are
+* shared in ROM, every instance keeps its attribute table, CCC state and
+* values.
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <ble_utils/ble_utils.hpp>
+
+namespace ble_utils::gatt
+{
+
+/**
+ * @brief Characteristic of a service template
+ */
+struct TemplateChrc
+{
+    /*! Declaration value shared by all instances, the value handle is resolved by zephyr */
+    bt_gatt_chrc decl;
+    /*! Permissions of the value (see zephyr enum bt_gatt_perm) */
+    uint16_t perm;
+
+    /**
+     * @brief Check if the characteristic has a CCC descriptor
+     *
+     * @return true for notify or indicate characteristics
+     */
+    constexpr bool has_ccc() const
+    {
+        return (decl.properties & (BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_INDICATE)) != 0;
+    }
+};
+
+/**
+ * @brief Define a characteristic of a service template
+ *
+ * @param uuid UUID of the characteristic
+ * @param props Properties (e.g. BT_GATT_CHRC_READ, BT_GATT_CHRC_NOTIFY)
+ * @param perm Permissions of the value (see zephyr enum bt_gatt_perm)
+ * @return Characteristic of the template
+ */
+constexpr TemplateChrc template_chrc(const bt_uuid &uuid, uint8_t props, uint16_t perm)
+{
+    return TemplateChrc{{&uuid, 0, props}, perm};
+}
+
+/**
+ * @brief Const description of a service with several instances
+ */
+struct ServiceTemplate
+{
+    const bt_uuid *uuid;
+    const TemplateChrc *chrcs;
+    uint8_t chrc_cnt;
+    /*! Number of characteristics with CCC */
+    uint8_t ccc_cnt;
+
+    /**
+     * @brief Construct a service template
+     *
+     * @param svc_uuid UUID of the service
+     * @param tmpl_chrcs Characteristics of the service in declaration order
+     */
+    template<size_t N>
+    constexpr ServiceTemplate(const bt_uuid &svc_uuid, const TemplateChrc (&tmpl_chrcs)[N]):
+        uuid(&svc_uuid),
+        chrcs(tmpl_chrcs),
+        chrc_cnt(N),
+        ccc_cnt(0)
+    {
+        static_assert(N > 0 && N <= UINT8_MAX, "Invalid number of characteristics");
+        for (size_t i = 0; i < N; i++) {
+            ccc_cnt += tmpl_chrcs[i].has_ccc() ? 1U : 0U;
+        }
+    }
+
+    /**
+     * @brief Number of attributes of an instance
+     *
+     * @return Service declaration, characteristic declarations, values and CCCs
+     */
+    constexpr size_t attr_cnt() const
+    {
+        return 1U + chrc_cnt * Characteristic::attr_size + ccc_cnt;
+    }
+};
+
+/**
+ * @brief Instance of a service template
+ * @details The callbacks get the index of the characteristic in the template. The attribute
+ *          of every instance is passed to zephyr, so reads, writes and notifications are
+ *          routed to the right instance even though all instances share the UUIDs. <br>
+ *          Use @ref ServiceInstance to allocate the attributes of a template.
+ */
+class IServiceInstance
+{
+public:
+    IServiceInstance(const IServiceInstance &) = delete;
+    IServiceInstance & operator=(const IServiceInstance &) = delete;
+
+    /**
+     * @brief Register the instance
+     *
+     * @return Zephyr return value from bt_gatt_service_register
+     */
+    int init();
+
+    /**
+     * @brief Send a notification of a characteristic of this instance
+     *
+     * @param chrc Index of the characteristic in the template
+     * @param data Pointer to data buffer
+     * @param len Length of the notification data
+     * @return The zephyr gatt result from the internal bt api
+     */
+    int notify(uint8_t chrc, const void *data, uint16_t len);
+
+    /**
+     * @brief Send an indication of a characteristic of this instance
+     * @details One indication per instance can be pending, @ref indicate_rsp is called
+     *          when it is confirmed.
+     *
+     * @param chrc Index of the characteristic in the template
+     * @param data Pointer to data buffer, must be valid until the indication is confirmed
+     * @param len Length of the indication data
+     * @return The zephyr gatt result from the internal bt api or -EBUSY if an indication
+     *         is pending
+     */
+    int indicate(uint8_t chrc, const void *data, uint16_t len);
+
+    /**
+     * @brief Check if a connection enabled notifications or indications
+     *
+     * @param conn Connection object
+     * @param chrc Index of the characteristic in the template
+     * @param type CCC type, BT_GATT_CCC_NOTIFY or BT_GATT_CCC_INDICATE
+     * @return true if the connection is subscribed
+     */
+    bool is_subscribed(bt_conn *conn, uint8_t chrc, uint16_t type) const;
+
+    /**
+     * @brief Read a characteristic of this instance
+     *
+     * @param conn Connection that requested the read
+     * @param chrc Index of the characteristic in the template
+     * @param buf Buffer to place the read result in
+     * @param len  Length of data to read
+     * @param offset Offset to start reading from
+     * @return Number of bytes read, or in case of an error
+     *          BT_GATT_ERR() with a specific BT_ATT_ERR_* error code.
+     */
+    virtual ssize_t read_cb(bt_conn *conn, uint8_t chrc, void *buf, uint16_t len, uint16_t offset)
+    {
+        ARG_UNUSED(conn);
+        ARG_UNUSED(chrc);
+        ARG_UNUSED(buf);
+        ARG_UNUSED(len);
+        ARG_UNUSED(offset);
+        return 0;
+    }
+
+    /**
+     * @brief Write a characteristic of this instance
+     *
+     * @param conn Connection that requested the write
+     * @param chrc Index of the characteristic in the template
+     * @param buf  Buffer with the data to write
+     * @param len Number of bytes in the buffer
+     * @param offset Offset to start writing from
+     * @param flags  Flags (``BT_GATT_WRITE_FLAG_*``)
+     * @return Number of bytes written, or in case of an error
+     *          BT_GATT_ERR() with a specific BT_ATT_ERR_* error code.
+     */
+    virtual ssize_t write_cb(bt_conn *conn, uint8_t chrc, const void *buf, uint16_t len,
+                             uint16_t offset, uint8_t flags)
+    {
+        ARG_UNUSED(conn);
+        ARG_UNUSED(chrc);
+        ARG_UNUSED(buf);
+        ARG_UNUSED(len);
+        ARG_UNUSED(offset);
+        ARG_UNUSED(flags);
+        return 0;
+    }
+
+    /**
+     * @brief CCC descriptor of a characteristic of this instance changed
+     *
+     * @param chrc Index of the characteristic in the template
+     * @param value The CCC Value that was changed
+     */
+    virtual void ccc_changed(uint8_t chrc, ICharacteristicCCC::CCCValue_e value)
+    {
+        ARG_UNUSED(chrc);
+        ARG_UNUSED(value);
+    }
+
+    /**
+     * @brief Indication of a characteristic of this instance was confirmed
+     *
+     * @param chrc Index of the characteristic in the template
+     */
+    virtual void indicate_rsp(uint8_t chrc)
+    {
+        ARG_UNUSED(chrc);
+    }
+
+protected:
+    /**
+     * @brief Custom struct to add context for ccc changed callback
+     */
+    struct InstanceCCC : public _bt_gatt_ccc
+    {
+        IServiceInstance *svc;
+    };
+
+    /**
+     * @brief Construct an instance on the attributes of a derived class
+     *
+     * @param tmpl Template of the service
+     * @param attrs Attributes of the instance, ServiceTemplate::attr_cnt entries
+     * @param ccc CCC state of the instance, ServiceTemplate::ccc_cnt entries
+     */
+    IServiceInstance(const ServiceTemplate &tmpl, bt_gatt_attr *attrs, InstanceCCC *ccc);
+
+private:
+    static ssize_t _read_cb(bt_conn *conn, const bt_gatt_attr *attr,
+                            void *buf, uint16_t len, uint16_t offset);
+    static ssize_t _write_cb(bt_conn *conn, const bt_gatt_attr *attr,
+                             const void *buf, uint16_t len, uint16_t offset, uint8_t flags);
+    static void _ccc_changed(const bt_gatt_attr *attr, uint16_t value);
+    static void _indicate_rsp(bt_gatt_indicate_params *params);
+#if defined(CONFIG_BLE_UTILS_TRACING) || defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+    static void _indicate_confirm(bt_conn *conn, bt_gatt_indicate_params *params, uint8_t err);
+#endif
+#if defined(CONFIG_BLE_UTILS_TRACING) || defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+    static void _notify_sent(bt_conn *conn, void *user_data);
+#endif
+
+    /**
+     * @brief Get the template index of the characteristic of an attribute
+     *
+     * @param attr Value or CCC attribute of this instance
+     * @return Index of the characteristic
+     */
+    uint8_t chrc_index(const bt_gatt_attr *attr) const;
+
+    /**
+     * @brief Get the value attribute of a characteristic
+     *
+     * @param chrc Index of the characteristic in the template
+     * @return Value attribute of this instance
+     */
+    const bt_gatt_attr *value_attr(uint8_t chrc) const;
+
+    const ServiceTemplate &m_tmpl;
+    bt_gatt_attr *const m_attrs;
+    bt_gatt_service m_gatt_service;
+    bt_gatt_indicate_params m_indicate_params;
+    bool m_indicate_pending{false};
+#if defined(CONFIG_BLE_UTILS_TRACING)
+    /*! Trace sequence number of the pending indication */
+    uint16_t m_trace_seq{0};
+#endif
+};
+
+/**
+ * @brief Instance of a service template with its attributes
+ * @details Example: <br>
+ *          static constexpr ble_utils::gatt::TemplateChrc sensor_chrcs[] = { <br>
+ *              ble_utils::gatt::template_chrc(uuid::temp.uuid, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+ *                                             BT_GATT_PERM_READ), <br>
+ *          }; <br>
+ *          static constexpr ble_utils::gatt::ServiceTemplate sensor_svc{uuid::svc.uuid, sensor_chrcs}; <br>
+ *          class Sensor : public ble_utils::gatt::ServiceInstance<sensor_svc> { ... }; <br>
+ *          Sensor sensors[16];
+ *
+ * @tparam Tmpl Static service template
+ */
+template<const ServiceTemplate &Tmpl>
+class ServiceInstance : public IServiceInstance
+{
+public:
+    ServiceInstance():
+        IServiceInstance(Tmpl, m_attrs, m_ccc)
+    {
+    }
+
+private:
+    bt_gatt_attr m_attrs[Tmpl.attr_cnt()];
+    InstanceCCC m_ccc[Tmpl.ccc_cnt > 0 ? Tmpl.ccc_cnt : 1];
+};
+
+} // namespace ble_utils::gatt
@@ -0,0 +1,118 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file notify_router.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* GATT client router that dispatches notifications and indications of
+* many subscriptions to their handlers in constant time.
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <stdint.h>
+
+namespace ble_utils::client
+{
+
+/**
+ * @brief Receiver of the notifications of a subscription
+ */
+class INotificationHandler
+{
+public:
+    /**
+     * @brief Callback for a received notification or indication
+     *
+     * @param conn Connection that sent the value
+     * @param value_handle Value handle of the characteristic
+     * @param data Value
+     * @param len Length of the value
+     */
+    virtual void notification(bt_conn *conn, uint16_t value_handle,
+                              const void *data, uint16_t len) = 0;
+
+    /**
+     * @brief Callback when the subscription was removed
+     * @details Called on @ref NotificationRouter::unsubscribe, when the peer disconnects
+     *          or when the CCC could not be written.
+     *
+     * @param conn Connection of the subscription
+     * @param value_handle Value handle of the characteristic
+     */
+    virtual void unsubscribed(bt_conn *conn, uint16_t value_handle)
+    {
+        ARG_UNUSED(conn);
+        ARG_UNUSED(value_handle);
+    }
+};
+
+/**
+ * @brief Pool of subscriptions with constant time dispatch
+ * @details The subscriptions are preallocated in a dense table indexed by the connection
+ *          index (see bt_conn_index) and a slot. Every subscription holds its handler next to
+ *          the zephyr subscribe parameters, so a notification reaches its handler without a
+ *          search or allocation. Slots are released when zephyr removes the subscription.
+ */
+class NotificationRouter
+{
+public:
+    /*! @brief Maximum subscriptions per connection */
+    static constexpr uint8_t MAX_SUBS = CONFIG_BLE_UTILS_NOTIFY_ROUTER_MAX_SUBS;
+
+    NotificationRouter();
+
+    NotificationRouter(const NotificationRouter &) = delete;
+    NotificationRouter & operator=(const NotificationRouter &) = delete;
+
+    /**
+     * @brief Subscribe to a characteristic
+     *
+     * @param conn Connection object
+     * @param value_handle Value handle of the characteristic
+     * @param ccc_handle Handle of the CCC descriptor
+     * @param ccc_value BT_GATT_CCC_NOTIFY or BT_GATT_CCC_INDICATE
+     * @param handler Receiver of the values
+     * @return 0 on success, -EALREADY if the handle is already subscribed, -ENOMEM if all the
+     *         slots of the connection are in use or the zephyr error of bt_gatt_subscribe
+     */
+    int subscribe(bt_conn *conn, uint16_t value_handle, uint16_t ccc_handle,
+                  uint16_t ccc_value, INotificationHandler &handler);
+
+    /**
+     * @brief Unsubscribe from a characteristic
+     *
+     * @param conn Connection object
+     * @param value_handle Value handle of the characteristic
+     * @return 0 on success, -ENOENT if the handle is not subscribed or
+     *         the zephyr error of bt_gatt_unsubscribe
+     */
+    int unsubscribe(bt_conn *conn, uint16_t value_handle);
+
+private:
+    /**
+     * @brief Subscription slot, keeps CONTAINER_OF on a standard layout type
+     */
+    struct Subscription
+    {
+        bt_gatt_subscribe_params params;
+        INotificationHandler *handler;  /*!< nullptr if the slot is free */
+    };
+
+    static uint8_t _notify_cb(bt_conn *conn, bt_gatt_subscribe_params *params,
+                              const void *data, uint16_t length);
+    static void _subscribe_cb(bt_conn *conn, uint8_t err, bt_gatt_subscribe_params *params);
+    static void release(bt_conn *conn, Subscription &sub);
+    Subscription * find(uint8_t conn_idx, uint16_t value_handle);
+
+    Subscription m_subs[CONFIG_BT_MAX_CONN][MAX_SUBS];
+};
+
+} // namespace ble_utils::client
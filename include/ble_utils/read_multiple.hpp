@@ -0,0 +1,125 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file read_multiple.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* GATT client helper that reads a set of characteristic values with
+* as few ATT Read Multiple requests as the MTU allows.
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <zephyr/bluetooth/gatt.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ble_utils::client
+{
+
+/**
+ * @brief Read a set of value handles in few round trips
+ * @details Consecutive items of the same kind are grouped into one request:
+ *          fixed size items with ATT Read Multiple and variable length items with
+ *          ATT Read Multiple Variable Length (CONFIG_BT_GATT_READ_MULT_VAR_LEN),
+ *          as long as the request and the expected response fit into the ATT MTU.
+ *          A group with a single item is read with a normal read. Values longer than
+ *          the MTU allows are truncated. <br>
+ *          Example: <br>
+ *          class StateSync : public ble_utils::client::ReadMultiple { ... }; <br>
+ *          static const ble_utils::client::ReadMultiple::Item items[] = {
+ *              {.handle = battery_handle, .len = 1, .variable = false},
+ *              {.handle = name_handle, .len = 20, .variable = true}}; <br>
+ *          StateSync sync(items); sync.read(conn);
+ */
+class ReadMultiple
+{
+public:
+    /**
+     * @brief Value to read
+     */
+    struct Item
+    {
+        uint16_t handle;    /*!< Value handle of the characteristic */
+        uint16_t len;       /*!< Exact length (fixed) or maximum length (variable) */
+        bool variable;      /*!< The value has a variable length */
+    };
+
+    /**
+     * @brief Construct a Read Multiple helper
+     *
+     * @param items Values to read, must be valid while a read is in progress
+     */
+    template<size_t N>
+    ReadMultiple(const Item (&items)[N]):
+        ReadMultiple(items, N){}
+
+    ReadMultiple(const Item *items, size_t cnt);
+
+    /**
+     * @brief Read all the values
+     *
+     * @param conn Connection object
+     * @return 0 if the read started, -EBUSY if a read is in progress or the
+     *         zephyr error of bt_gatt_read
+     */
+    int read(bt_conn *conn);
+
+    /**
+     * @brief Callback for every value that was read
+     *
+     * @param idx Index of the item
+     * @param data Value
+     * @param len Length of the value
+     */
+    virtual void value_read(size_t idx, const void *data, uint16_t len) = 0;
+
+    /**
+     * @brief Callback when the read finished
+     *
+     * @param err 0 on success, the ATT error code of the failed request or a
+     *            negative zephyr error if a request could not be sent
+     */
+    virtual void read_done(int err)
+    {
+        ARG_UNUSED(err);
+    }
+
+private:
+    /*! @brief Maximum handles of a request */
+    static constexpr size_t MAX_HANDLES = CONFIG_BLE_UTILS_READ_MULTIPLE_MAX_HANDLES;
+
+    /**
+     * @brief Read parameters with context, keeps CONTAINER_OF on a standard layout type
+     */
+    struct Params
+    {
+        bt_gatt_read_params params;
+        ReadMultiple *self;
+    };
+
+    static uint8_t _read_cb(bt_conn *conn, uint8_t err, bt_gatt_read_params *params,
+                            const void *data, uint16_t length);
+    uint8_t read_cb(bt_conn *conn, uint8_t err, const void *data, uint16_t length);
+    int next(bt_conn *conn);
+    void finish(int err);
+
+    const Item *m_items;
+    const size_t m_cnt;
+    /*! First item of the current request */
+    size_t m_first{0};
+    /*! Items of the current request */
+    size_t m_chunk{0};
+    /*! Next value of the current request that is expected */
+    size_t m_value{0};
+    bool m_busy{false};
+    uint16_t m_handles[MAX_HANDLES];
+    Params m_params;
+};
+
+} // namespace ble_utils::client
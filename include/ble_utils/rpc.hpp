@@ -0,0 +1,224 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file rpc.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Pipelined request/response characteristic. Requests are received as
+* write without response and answered with notifications.
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <ble_utils/ble_utils.hpp>
+#include <ble_utils/session.hpp>
+#include <zephyr/kernel.h>
+
+namespace ble_utils::gatt
+{
+
+class RpcCharacteristic;
+
+namespace rpc
+{
+/*! @brief Request frame header: sequence id and opcode */
+static constexpr uint8_t REQ_HDR_SIZE{2U};
+/*! @brief Response frame header: sequence id, opcode and status */
+static constexpr uint8_t RSP_HDR_SIZE{3U};
+/*! @brief Maximum request payload */
+static constexpr uint16_t MAX_REQ_LEN = CONFIG_BLE_UTILS_RPC_MAX_REQ_LEN;
+/*! @brief Maximum response payload */
+static constexpr uint16_t MAX_RSP_LEN = CONFIG_BLE_UTILS_RPC_MAX_RSP_LEN;
+/*! @brief Maximum requests in flight per connection */
+static constexpr uint8_t MAX_INFLIGHT = CONFIG_BLE_UTILS_RPC_MAX_INFLIGHT;
+
+/**
+ * @brief Status sent in the response frame
+ */
+enum class Status : uint8_t
+{
+    Ok = 0,             /*!< Request executed */
+    UnknownOpcode = 1,  /*!< No handler for the opcode */
+    InvalidLength = 2,  /*!< Request payload has an invalid length */
+    Error = 3,          /*!< Handler failed */
+    Pending = 0xFF      /*!< Handler completes later with RpcCharacteristic::complete (never sent) */
+};
+
+/**
+ * @brief Order in which responses are sent
+ */
+enum class Order
+{
+    InOrder,    /*!< Responses are sent in the order of the requests of a connection */
+    OutOfOrder  /*!< Responses are sent as soon as the request completes */
+};
+
+/**
+ * @brief Identifies a pending request for asynchronous completion
+ */
+struct Token
+{
+    uint8_t conn_idx;
+    uint8_t slot;
+    uint8_t seq;
+};
+
+/**
+ * @brief Request passed to a handler
+ */
+struct Request
+{
+    bt_conn *conn;          /*!< Connection that sent the request */
+    void *ctx;              /*!< Context given to the RpcCharacteristic */
+    Token token;            /*!< Token for RpcCharacteristic::complete */
+    uint8_t opcode;         /*!< Opcode of the request */
+    const uint8_t *data;    /*!< Request payload */
+    uint16_t len;           /*!< Request payload length */
+};
+
+/**
+ * @brief Response buffer filled by a synchronous handler
+ */
+struct Response
+{
+    uint8_t *data;          /*!< Response payload buffer */
+    uint16_t max_len;       /*!< Size of the response payload buffer */
+    uint16_t len;           /*!< Response payload length written by the handler */
+};
+
+/**
+ * @brief Request handler
+ * @details Handlers are called from the system work queue. A handler can fill the response
+ *          and return its status or return Status::Pending and complete the request later.
+ */
+using HandlerFunc = Status (*)(const Request &req, Response &rsp);
+
+/**
+ * @brief Entry of the opcode to handler table
+ */
+struct Handler
+{
+    uint8_t opcode;
+    HandlerFunc func;
+};
+
+/**
+ * @brief Check that a handler table is sorted by unique opcodes
+ * @details Example: static_assert(ble_utils::gatt::rpc::is_sorted(my_handlers));
+ */
+template<size_t N>
+constexpr bool is_sorted(const Handler (&table)[N])
+{
+    for (size_t i = 1; i < N; i++) {
+        if (table[i - 1].opcode >= table[i].opcode) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace rpc
+
+/**
+ * @brief Characteristic that executes pipelined requests
+ * @details Request frame (write without response): | seq | opcode | payload | <br>
+ *          Response frame (notification): | seq | opcode | status | payload | <br>
+ *          A read returns | max. in flight (u8) | max. request payload (u16) | max. response payload (u16) |
+ *          so clients can size their request window. Requests that exceed the window are dropped.
+ *          The requests of a client that disconnects are released without a response.
+ */
+class RpcCharacteristic : public CharacteristicNotify, private ISessionPool
+{
+public:
+    /**
+     * @brief Construct a RPC Characteristic
+     *
+     * @param uuid UUID assigned to the characteristic
+     * @param handlers Opcode to handler table sorted by opcode (see rpc::is_sorted)
+     * @param order Order in which responses are sent
+     * @param ctx Context passed to the handlers
+     */
+    template<size_t N>
+    RpcCharacteristic(const bt_uuid * uuid, const rpc::Handler (&handlers)[N],
+                      rpc::Order order, void *ctx = nullptr):
+        RpcCharacteristic(uuid, handlers, N, order, ctx){}
+
+    /**
+     * @brief Complete a request whose handler returned Status::Pending
+     *
+     * @param token Token of the request
+     * @param status Status of the response
+     * @param data Response payload
+     * @param len Response payload length
+     * @return 0 on success, -EINVAL if the token is not pending, -EMSGSIZE if the payload is too large,
+     *         -ENOTCONN if the client disconnected, the request is released without a response
+     */
+    int complete(const rpc::Token &token, rpc::Status status, const void *data, uint16_t len);
+
+private:
+    RpcCharacteristic(const bt_uuid * uuid, const rpc::Handler *handlers, size_t handler_cnt,
+                      rpc::Order order, void *ctx);
+
+    ssize_t read_cb(void *buf, uint16_t len, uint16_t offset) override;
+    ssize_t conn_write_cb(bt_conn *conn, const void *buf, uint16_t len,
+                          uint16_t offset, uint8_t flags) override;
+    void release(uint8_t conn_idx) override;
+
+    enum class SlotState : uint8_t
+    {
+        Free,
+        Reserved,
+        Queued,
+        Pending,
+        Done
+    };
+
+    /**
+     * @brief Request in flight
+     */
+    struct Slot
+    {
+        bt_conn *conn;
+        uint32_t order;         /*!< Arrival order of the request */
+        SlotState state;
+        bool dropped;           /*!< The client disconnected, no response is sent */
+        uint16_t req_len;
+        uint16_t rsp_len;
+        uint8_t req[rpc::REQ_HDR_SIZE + rpc::MAX_REQ_LEN];
+        uint8_t rsp[rpc::RSP_HDR_SIZE + rpc::MAX_RSP_LEN];
+    };
+
+    /**
+     * @brief Work item with context, keeps CONTAINER_OF on a standard layout type
+     */
+    struct Work
+    {
+        k_work_delayable work;
+        RpcCharacteristic *rpc;
+    };
+
+    static void _work_handler(k_work *work);
+    rpc::HandlerFunc find_handler(uint8_t opcode) const;
+    Slot * oldest(uint8_t conn_idx, bool done_only);
+    Slot * next_queued(uint8_t &conn_idx, uint8_t &slot_idx);
+    void execute(uint8_t conn_idx, uint8_t slot_idx);
+    void finish(Slot &slot, rpc::Status status, uint16_t rsp_len);
+    void discard();
+    bool flush();
+    void free_slot(Slot &slot);
+
+    const rpc::Handler *m_handlers;
+    const size_t m_handler_cnt;
+    const rpc::Order m_order;
+    void * const m_ctx;
+    uint32_t m_arrival{0};
+    Slot m_slots[CONFIG_BT_MAX_CONN][rpc::MAX_INFLIGHT];
+    k_spinlock m_lock;
+    Work m_work;
+};
+
+} // namespace ble_utils::gatt
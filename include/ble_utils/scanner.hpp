@@ -0,0 +1,249 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file scanner.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Scanner that matches advertising reports against a service UUID
+* filter table generated at compile time.
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ble_utils::scan
+{
+
+/**
+ * @brief Sorted UUID tables used to match AD elements
+ * @details The 16 and 32 bit tables are sorted by value, the 128 bit table is sorted
+ *          by its little endian bytes as they appear in the advertising data.
+ *          Lookups use a binary search directly on the advertising data.
+ */
+struct FilterTable
+{
+    const uint16_t *uuid16;
+    size_t cnt16;
+    const uint32_t *uuid32;
+    size_t cnt32;
+    const uint8_t (*uuid128)[BT_UUID_SIZE_128];
+    size_t cnt128;
+
+    /**
+     * @brief Check if an AD element contains one of the UUIDs of the table
+     * @details Only the UUID list and service data AD types are considered.
+     *
+     * @param type AD type
+     * @param data Pointer to the AD element data
+     * @param len Length of the AD element data
+     * @return true if a UUID of the table was found
+     */
+    bool match(uint8_t type, const uint8_t *data, uint8_t len) const;
+};
+
+namespace detail
+{
+template<typename T, size_t N>
+struct Table
+{
+    T val[N > 0 ? N : 1];
+};
+
+template<typename T, size_t N>
+constexpr void sort(Table<T, N> &table, bool (*less)(const T &, const T &))
+{
+    for (size_t i = 1; i < N; i++) {
+        for (size_t j = i; j > 0 && less(table.val[j], table.val[j - 1]); j--) {
+            const T tmp = table.val[j];
+            table.val[j] = table.val[j - 1];
+            table.val[j - 1] = tmp;
+        }
+    }
+}
+
+/*! @brief Table of 128 bit UUIDs, the rows are contiguous like the FilterTable expects */
+template<size_t N>
+struct Table128
+{
+    uint8_t val[N > 0 ? N : 1][BT_UUID_SIZE_128];
+};
+
+constexpr bool less_u16(const uint16_t &a, const uint16_t &b) { return a < b; }
+constexpr bool less_u32(const uint32_t &a, const uint32_t &b) { return a < b; }
+constexpr bool less_u128(const uint8_t (&a)[BT_UUID_SIZE_128], const uint8_t (&b)[BT_UUID_SIZE_128])
+{
+    for (size_t i = 0; i < BT_UUID_SIZE_128; i++) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i];
+        }
+    }
+    return false;
+}
+
+template<size_t N>
+constexpr void sort(Table128<N> &table)
+{
+    for (size_t i = 1; i < N; i++) {
+        for (size_t j = i; j > 0 && less_u128(table.val[j], table.val[j - 1]); j--) {
+            for (size_t k = 0; k < BT_UUID_SIZE_128; k++) {
+                const uint8_t tmp = table.val[j][k];
+                table.val[j][k] = table.val[j - 1][k];
+                table.val[j - 1][k] = tmp;
+            }
+        }
+    }
+}
+
+constexpr void put(const bt_uuid_16 &uuid, uint16_t *u16, uint32_t *, uint8_t (*)[BT_UUID_SIZE_128],
+                   size_t &i16, size_t &, size_t &)
+{
+    u16[i16++] = uuid.val;
+}
+
+constexpr void put(const bt_uuid_32 &uuid, uint16_t *, uint32_t *u32, uint8_t (*)[BT_UUID_SIZE_128],
+                   size_t &, size_t &i32, size_t &)
+{
+    u32[i32++] = uuid.val;
+}
+
+constexpr void put(const bt_uuid_128 &uuid, uint16_t *, uint32_t *, uint8_t (*u128)[BT_UUID_SIZE_128],
+                   size_t &, size_t &, size_t &i128)
+{
+    for (size_t i = 0; i < BT_UUID_SIZE_128; i++) {
+        u128[i128][i] = uuid.val[i];
+    }
+    i128++;
+}
+} // namespace detail
+
+/**
+ * @brief Compile-time UUID filter
+ * @details Example: <br>
+ *          using filter = ble_utils::scan::UuidFilter<product_a_uuid, product_b_uuid>;
+ *          MyScanner scanner(filter::table);
+ *
+ * @tparam Uuids Static bt_uuid_16, bt_uuid_32 or bt_uuid_128 objects to match
+ */
+template<const auto &... Uuids>
+class UuidFilter
+{
+    static_assert(sizeof...(Uuids) > 0, "At least one UUID is required");
+
+    static constexpr size_t cnt(uint8_t type)
+    {
+        return (0U + ... + (Uuids.uuid.type == type ? 1U : 0U));
+    }
+
+    static constexpr size_t n16 = cnt(BT_UUID_TYPE_16);
+    static constexpr size_t n32 = cnt(BT_UUID_TYPE_32);
+    static constexpr size_t n128 = cnt(BT_UUID_TYPE_128);
+
+    struct Tables
+    {
+        detail::Table<uint16_t, n16> u16;
+        detail::Table<uint32_t, n32> u32;
+        detail::Table128<n128> u128;
+    };
+
+    static constexpr Tables build()
+    {
+        Tables tables{};
+        size_t i16 = 0;
+        size_t i32 = 0;
+        size_t i128 = 0;
+        (detail::put(Uuids, tables.u16.val, tables.u32.val, tables.u128.val, i16, i32, i128), ...);
+        detail::sort(tables.u16, detail::less_u16);
+        detail::sort(tables.u32, detail::less_u32);
+        detail::sort(tables.u128);
+        return tables;
+    }
+
+    static constexpr Tables tables = build();
+
+public:
+    /*! @brief Filter table placed in ROM */
+    static constexpr FilterTable table
+    {
+        .uuid16 = tables.u16.val,
+        .cnt16 = n16,
+        .uuid32 = tables.u32.val,
+        .cnt32 = n32,
+        .uuid128 = tables.u128.val,
+        .cnt128 = n128
+    };
+};
+
+/**
+ * @brief Scanner that delivers only devices advertising a UUID of a filter table
+ * @details Advertising reports are matched in place, without copying the UUIDs.
+ *          Reports of a device that was already delivered are suppressed for
+ *          CONFIG_BLE_UTILS_SCANNER_DUP_WINDOW_MS. Only one scanner can be active at a time.
+ */
+class Scanner
+{
+public:
+    /**
+     * @brief Construct a Scanner
+     *
+     * @param filter Filter table (see @ref UuidFilter)
+     */
+    explicit Scanner(const FilterTable &filter);
+
+    /**
+     * @brief Start scanning
+     * @details Clears the duplicate cache.
+     *
+     * @param param Zephyr scan parameters
+     * @return Zephyr return value from bt_le_scan_start
+     */
+    int start(const bt_le_scan_param &param);
+
+    /**
+     * @brief Stop scanning
+     *
+     * @return Zephyr return value from bt_le_scan_stop
+     */
+    int stop();
+
+    /**
+     * @brief Callback for a device that matched the filter
+     *
+     * @param info Advertising report information
+     * @param ad Advertising data of the report
+     */
+    virtual void device_found(const bt_le_scan_recv_info *info, net_buf_simple *ad) = 0;
+
+    virtual ~Scanner() = default;
+
+private:
+    static constexpr uint8_t DUP_CACHE_SIZE = CONFIG_BLE_UTILS_SCANNER_DUP_CACHE_SIZE;
+
+    /**
+     * @brief Recently delivered device
+     */
+    struct DupEntry
+    {
+        bt_addr_le_t addr;
+        uint32_t timestamp;
+        bool valid;
+    };
+
+    static void _recv(const bt_le_scan_recv_info *info, net_buf_simple *buf);
+    bool matches(const net_buf_simple *ad) const;
+    bool is_duplicate(const bt_le_scan_recv_info *info);
+
+    const FilterTable &m_filter;
+    DupEntry m_dup_cache[DUP_CACHE_SIZE];
+    uint8_t m_dup_next{0};
+};
+
+} // namespace ble_utils::scan
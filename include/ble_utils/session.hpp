@@ -0,0 +1,118 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file session.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Per-connection session state for characteristics
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <zephyr/bluetooth/conn.h>
+
+namespace ble_utils::gatt
+{
+
+/**
+ * @brief Base of all session pools
+ * @details Every pool is linked into a list that releases the sessions
+ *          of a connection when it disconnects.
+ */
+class ISessionPool
+{
+public:
+    ISessionPool();
+    virtual ~ISessionPool();
+
+    ISessionPool(const ISessionPool &) = delete;
+    ISessionPool & operator=(const ISessionPool &) = delete;
+
+    /**
+     * @brief Release the session of a connection
+     *
+     * @param conn_idx Connection index (see bt_conn_index)
+     */
+    virtual void release(uint8_t conn_idx) = 0;
+
+private:
+    friend void release_sessions(uint8_t conn_idx);
+    ISessionPool *m_next;
+};
+
+/**
+ * @brief Release the sessions of a connection in all the pools
+ * @details Called by the library on disconnect.
+ *
+ * @param conn_idx Connection index (see bt_conn_index)
+ */
+void release_sessions(uint8_t conn_idx);
+
+/**
+ * @brief Fixed pool with one session per connection
+ * @details Sessions are indexed by bt_conn_index(), so an access is O(1). A session is
+ *          default constructed on first access of a connection and released on disconnect. <br>
+ *          Example: <br>
+ *          class Stream : public ble_utils::gatt::Characteristic
+ *          {
+ *              struct Cursor { uint32_t pos; };
+ *              ble_utils::gatt::Sessions<Cursor> m_sessions;
+ *              ssize_t conn_read_cb(bt_conn *conn, void *buf, uint16_t len, uint16_t offset) override
+ *              {
+ *                  Cursor &cursor = m_sessions.get(conn);
+ *                  ...
+ *              }
+ *          };
+ *
+ * @tparam T Default constructible session state
+ */
+template<typename T>
+class Sessions : public ISessionPool
+{
+public:
+    Sessions() = default;
+
+    /**
+     * @brief Get the session of a connection, it is created if it does not exist
+     *
+     * @param conn Connection object
+     * @return Session of the connection
+     */
+    T & get(const bt_conn *conn)
+    {
+        const uint8_t idx = bt_conn_index(conn);
+        if (!m_active[idx]) {
+            m_sessions[idx] = T{};
+            m_active[idx] = true;
+        }
+        return m_sessions[idx];
+    }
+
+    /**
+     * @brief Find the session of a connection without creating it
+     *
+     * @param conn Connection object
+     * @return Pointer to the session or nullptr if the connection has none
+     */
+    T * find(const bt_conn *conn)
+    {
+        const uint8_t idx = bt_conn_index(conn);
+        return m_active[idx] ? &m_sessions[idx] : nullptr;
+    }
+
+    void release(uint8_t conn_idx) override
+    {
+        m_active[conn_idx] = false;
+    }
+
+private:
+    T m_sessions[CONFIG_BT_MAX_CONN]{};
+    bool m_active[CONFIG_BT_MAX_CONN]{};
+};
+
+} // namespace ble_utils::gatt
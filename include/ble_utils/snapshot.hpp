@@ -0,0 +1,122 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file snapshot.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Snapshot characteristic with the values of all readable characteristics
+* of a service, so a client syncs the whole state with one request.
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <ble_utils/ble_utils.hpp>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+namespace ble_utils::gatt
+{
+
+namespace snapshot
+{
+/*! @brief Entry header, value handle (LE16) and value length (LE16) followed by the value */
+static constexpr uint8_t ENTRY_HDR_SIZE{4U};
+} // namespace snapshot
+
+/**
+ * @brief Characteristic with the values of the readable characteristics of a service
+ * @details A read at offset 0 calls @ref Characteristic::conn_read_cb of every characteristic
+ *          of the service with BT_GATT_CHRC_READ and concatenates the values as entries of
+ *          [value handle][length][value]. The snapshot is kept per connection, so a long read
+ *          returns a consistent state. Values whose read permissions are not covered by the
+ *          snapshot permissions are left out, as are values that do not fit into
+ *          CONFIG_BLE_UTILS_SNAPSHOT_MAX_LEN. <br>
+ *          When a connection subscribes, the snapshot is notified to it in as few
+ *          notifications as the ATT MTU allows, every notification holds complete entries.
+ *          Entries larger than a notification are skipped and have to be read. <br>
+ *          Example: <br>
+ *          ble_utils::gatt::Snapshot snapshot(&uuid::snapshot, service); <br>
+ *          service.register_char(&snapshot);
+ */
+class Snapshot : public CharacteristicNotify
+{
+public:
+    /*! @brief Maximum length of a snapshot */
+    static constexpr uint16_t MAX_LEN = CONFIG_BLE_UTILS_SNAPSHOT_MAX_LEN;
+
+    /**
+     * @brief Construct a snapshot characteristic
+     *
+     * @param uuid UUID assigned to the characteristic
+     * @param svc Service whose characteristics are in the snapshot, the snapshot has to be
+     *            registered to it
+     * @param perm Permissions of the characteristic (see zephyr enum bt_gatt_perm)
+     *             BT_GATT_PERM_READ is initialized by default.
+     */
+    Snapshot(const bt_uuid * uuid, Service &svc, uint8_t perm = 0);
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot & operator=(const Snapshot &) = delete;
+
+    ssize_t conn_read_cb(bt_conn *conn, void *buf, uint16_t len, uint16_t offset) override;
+
+    void conn_ccc_written(bt_conn *conn, CCCValue_e value) override;
+
+private:
+    /**
+     * @brief Work item with context, keeps CONTAINER_OF on a standard layout type
+     */
+    struct NotifyWork
+    {
+        k_work_delayable work;
+        Snapshot *chrc;
+    };
+
+    static void _notify_handler(k_work *work);
+
+    /**
+     * @brief Read the values of the service into a snapshot
+     *
+     * @param conn Connection that gets the snapshot
+     * @param buf Buffer of @ref MAX_LEN + 1 bytes
+     * @return Length of the snapshot
+     */
+    uint16_t build(bt_conn *conn, uint8_t *buf) const;
+
+    /**
+     * @brief Get the registered value attribute of the snapshot
+     *
+     * @return Value attribute or nullptr if the snapshot is not registered
+     */
+    const bt_gatt_attr *value_attr() const;
+
+    /**
+     * @brief Notify the snapshot to the connection in @ref m_tx_idx
+     *
+     * @return 0 when done or -ENOMEM if it has to be retried
+     */
+    int send();
+
+    /*! Index of the connection that is notified, none if equal to CONFIG_BT_MAX_CONN */
+    static constexpr uint8_t TX_IDLE{CONFIG_BT_MAX_CONN};
+
+    Service &m_svc;
+    /*! Snapshot of each connection for long reads */
+    uint8_t m_read_buf[CONFIG_BT_MAX_CONN][MAX_LEN + 1];
+    uint16_t m_read_len[CONFIG_BT_MAX_CONN]{};
+    /*! Snapshot that is notified and the offset of its next entry */
+    uint8_t m_tx_buf[MAX_LEN + 1];
+    uint16_t m_tx_len{0};
+    uint16_t m_tx_pos{0};
+    uint8_t m_tx_idx{TX_IDLE};
+    /*! Connections that subscribed and wait for the snapshot */
+    ATOMIC_DEFINE(m_pending, CONFIG_BT_MAX_CONN);
+    NotifyWork m_work;
+};
+
+} // namespace ble_utils::gatt
@@ -0,0 +1,210 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file upload.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Reliable client to peripheral uploads with a sliding window over
+* write without response.
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <ble_utils/ble_utils.hpp>
+#include <ble_utils/session.hpp>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+namespace ble_utils::gatt
+{
+
+/**
+ * @brief Wire format of an upload
+ * @details Control (write to the ack characteristic): <br>
+ *          [OP_START][size u32] starts a transfer, [OP_ABORT] cancels it. <br>
+ *          Chunk (write without response to the data characteristic): <br>
+ *          [seq u16][payload], seq starts at 0 for every transfer. <br>
+ *          Ack (notification of the ack characteristic): <br>
+ *          [next seq u16][window u8][Status u8]. All chunks before next seq were received,
+ *          the sender may send the sequence numbers [next seq, next seq + window).
+ *          A repeated ack means chunks were lost and the sender goes back to next seq.
+ *          All values are little endian.
+ */
+namespace upload
+{
+    constexpr uint8_t OP_START = 0x01U;
+    constexpr uint8_t OP_ABORT = 0x02U;
+    constexpr uint8_t START_SIZE = 5U;
+    constexpr uint8_t CHUNK_HDR_SIZE = 2U;
+    constexpr uint8_t ACK_SIZE = 4U;
+
+    /*! @brief Maximum payload of a chunk */
+    constexpr uint16_t CHUNK_SIZE = CONFIG_BLE_UTILS_UPLOAD_CHUNK_SIZE;
+    /*! @brief Chunks that can be in flight */
+    constexpr uint8_t WINDOW = CONFIG_BLE_UTILS_UPLOAD_WINDOW;
+
+    enum class Status : uint8_t
+    {
+        Idle=0,         /*!< No transfer */
+        Starting,       /*!< The sink prepares the transfer, the window is 0 */
+        Active,         /*!< Chunks are accepted */
+        Complete,       /*!< All data was written to the sink */
+        Error           /*!< The transfer failed or was aborted */
+    };
+}
+
+/**
+ * @brief Destination of an upload (e.g. a flash area)
+ * @details The sink is called from the system work queue, so it may block. While it
+ *          writes, the received chunks wait in the window buffer and the window that
+ *          is advertised to the client shrinks.
+ */
+class IUploadSink
+{
+public:
+    /**
+     * @brief A transfer starts
+     *
+     * @param size Total size of the transfer
+     * @return 0 on success or a negative error code to reject the transfer
+     */
+    virtual int begin(uint32_t size) = 0;
+
+    /**
+     * @brief Write received data
+     *
+     * @param offset Offset of the data in the transfer
+     * @param data Pointer to the data
+     * @param len Length of the data
+     * @return 0 on success or a negative error code that fails the transfer
+     */
+    virtual int write(uint32_t offset, const void *data, uint16_t len) = 0;
+
+    /**
+     * @brief The transfer ended
+     *
+     * @param err 0 if all data was written, -ECONNABORTED if the client aborted,
+     *            -ENOTCONN if the client disconnected or the error of @ref write
+     */
+    virtual void end(int err) = 0;
+};
+
+/**
+ * @brief Characteristic pair for windowed uploads
+ * @details Chunks are received with write without response into a window of
+ *          CONFIG_BLE_UTILS_UPLOAD_WINDOW slots and written to the sink in order.
+ *          Cumulative acks with the free window are notified after the sink consumed
+ *          chunks and when a chunk is out of order, so the link stays full without
+ *          overrunning the device. One transfer can be active at a time. <br>
+ *          Example: <br>
+ *          ble_utils::gatt::Upload upload(&uuid::fw_data, &uuid::fw_ack, flash_sink); <br>
+ *          service.register_char(upload.data_chrc()); <br>
+ *          service.register_char(upload.ack_chrc());
+ */
+class Upload : private ISessionPool
+{
+public:
+    /**
+     * @brief Construct an upload
+     *
+     * @param data_uuid UUID of the data characteristic
+     * @param ack_uuid UUID of the ack and control characteristic
+     * @param sink Destination of the uploaded data
+     */
+    Upload(const bt_uuid *data_uuid, const bt_uuid *ack_uuid, IUploadSink &sink);
+
+    /**
+     * @brief Get the data characteristic to register it in a service
+     */
+    const Characteristic * data_chrc() const;
+
+    /**
+     * @brief Get the ack characteristic to register it in a service
+     */
+    const Characteristic * ack_chrc() const;
+
+    /**
+     * @brief Get the status of the last transfer
+     */
+    upload::Status status() const;
+
+private:
+    class DataCharacteristic : public Characteristic
+    {
+    public:
+        DataCharacteristic(const bt_uuid *uuid, Upload &upload);
+        ssize_t conn_write_cb(bt_conn *conn, const void *buf, uint16_t len,
+                              uint16_t offset, uint8_t flags) override;
+    private:
+        Upload &m_upload;
+    };
+
+    class AckCharacteristic : public CharacteristicNotify
+    {
+    public:
+        AckCharacteristic(const bt_uuid *uuid, Upload &upload);
+        ssize_t conn_write_cb(bt_conn *conn, const void *buf, uint16_t len,
+                              uint16_t offset, uint8_t flags) override;
+    private:
+        Upload &m_upload;
+    };
+
+    /**
+     * @brief Work item with context, keeps CONTAINER_OF on a standard layout type
+     */
+    struct Work
+    {
+        k_work work;
+        Upload *self;
+    };
+
+    /**
+     * @brief Received chunk waiting for the sink
+     */
+    struct Slot
+    {
+        uint8_t data[upload::CHUNK_SIZE];
+        uint16_t len;
+    };
+
+    /*! @brief Bits of @ref m_events */
+    enum Event
+    {
+        EVT_ACK=0,          /*!< Send an ack even if nothing was written */
+        EVT_ABORT,          /*!< The client aborted */
+        EVT_DISCONNECT      /*!< The client disconnected */
+    };
+
+    ssize_t control(bt_conn *conn, const uint8_t *buf, uint16_t len);
+    ssize_t chunk(bt_conn *conn, const uint8_t *buf, uint16_t len);
+    void release(uint8_t conn_idx) override;
+    static void _work_handler(k_work *work);
+    void process();
+    int drain();
+    void finish(int err);
+    void ack(upload::Status state);
+
+    IUploadSink &m_sink;
+    DataCharacteristic m_data;
+    AckCharacteristic m_ack;
+    Work m_work;
+    const bt_gatt_attr *m_ack_attr{nullptr};
+    /*! Client of the transfer, referenced until it ends */
+    bt_conn *m_conn{nullptr};
+    uint32_t m_size{0};
+    uint32_t m_offset{0};
+    atomic_t m_status{ATOMIC_INIT(0)};
+    atomic_t m_events{ATOMIC_INIT(0)};
+    /*! Received chunks, written by the bt receive thread */
+    atomic_t m_rx_seq{ATOMIC_INIT(0)};
+    /*! Chunks written to the sink, written by the work queue */
+    atomic_t m_sink_seq{ATOMIC_INIT(0)};
+    Slot m_slots[upload::WINDOW];
+};
+
+} // namespace ble_utils::gatt
@@ -0,0 +1,121 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file zbus.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Characteristics bound to Zephyr zbus channels. Reads are served from
+* the channel message and publishes are notified.
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#pragma once
+
+#include <ble_utils/ble_utils.hpp>
+#include <zephyr/kernel.h>
+#include <zephyr/zbus/zbus.h>
+
+/**
+ * @brief Listener that notifies the bound characteristics of a channel
+ * @details Add it to the observers of every channel with a @ref ble_utils::gatt::ZbusCharacteristicNotify,
+ *          e.g. ZBUS_CHAN_DEFINE(..., ZBUS_OBSERVERS(ble_utils_zbus_listener), ...)
+ */
+ZBUS_OBS_DECLARE(ble_utils_zbus_listener);
+
+namespace ble_utils::gatt
+{
+
+/**
+ * @brief Schedule the notifications of the characteristics bound to a channel
+ * @details Called by ble_utils_zbus_listener, an application listener of the channel can
+ *          call it instead.
+ *
+ * @param chan Channel that was published
+ */
+void zbus_published(const zbus_channel *chan);
+
+/**
+ * @brief Read only characteristic with the message of a zbus channel
+ * @details Reads claim the channel and copy from its message, so no application copy of
+ *          the value is kept.
+ */
+class ZbusCharacteristic : public Characteristic
+{
+public:
+    /**
+     * @brief Construct a characteristic bound to a channel
+     *
+     * @param uuid UUID assigned to the characteristic
+     * @param chan Channel with the value
+     * @param props Properties that are assigned to the characteristic.
+     *               BT_GATT_CHRC_READ is initialized by default.
+     * @param perm Permissions of the characteristic (see zephyr enum bt_gatt_perm)
+     *             BT_GATT_PERM_READ is initialized by default.
+     */
+    ZbusCharacteristic(const bt_uuid * uuid, const zbus_channel &chan,
+                       uint8_t props = 0, uint8_t perm = 0);
+
+    ssize_t read_cb(void *buf, uint16_t len, uint16_t offset) override;
+
+private:
+    const zbus_channel &m_chan;
+};
+
+/**
+ * @brief Notify characteristic with the message of a zbus channel
+ * @details Reads are served like @ref ZbusCharacteristic. Every publish on the channel
+ *          schedules a notification from the system work queue through the listener
+ *          ble_utils_zbus_listener. Publishes within CONFIG_BLE_UTILS_ZBUS_COALESCE_MS, or
+ *          while a notification is pending, are sent once with the latest message. <br>
+ *          Example: <br>
+ *          ZBUS_CHAN_DEFINE(temp_chan, struct temp_msg, NULL, NULL,
+ *                           ZBUS_OBSERVERS(ble_utils_zbus_listener), ZBUS_MSG_INIT(0)); <br>
+ *          ble_utils::gatt::ZbusCharacteristicNotify temp(&uuid::temp, temp_chan); <br>
+ *          service.register_char(&temp);
+ */
+class ZbusCharacteristicNotify : public CharacteristicNotify
+{
+public:
+    /**
+     * @brief Construct a notify characteristic bound to a channel
+     *
+     * @param uuid UUID assigned to the characteristic
+     * @param chan Channel with the value, must be observed by ble_utils_zbus_listener
+     * @param props Properties that are assigned to the characteristic.
+     *               BT_GATT_CHRC_READ and BT_GATT_CHRC_NOTIFY are initialized by default.
+     * @param perm Permissions of the characteristic (see zephyr enum bt_gatt_perm)
+     *             BT_GATT_PERM_READ is initialized by default.
+     */
+    ZbusCharacteristicNotify(const bt_uuid * uuid, const zbus_channel &chan,
+                             uint8_t props = 0, uint8_t perm = 0);
+
+    ZbusCharacteristicNotify(const ZbusCharacteristicNotify &) = delete;
+    ZbusCharacteristicNotify & operator=(const ZbusCharacteristicNotify &) = delete;
+
+    ssize_t read_cb(void *buf, uint16_t len, uint16_t offset) override;
+
+private:
+    /**
+     * @brief Work item with context, keeps CONTAINER_OF on a standard layout type
+     */
+    struct NotifyWork
+    {
+        k_work_delayable work;
+        ZbusCharacteristicNotify *chrc;
+    };
+
+    static void _notify_handler(k_work *work);
+
+    const zbus_channel &m_chan;
+    NotifyWork m_work;
+    /*! Next characteristic bound to any channel */
+    ZbusCharacteristicNotify *m_next;
+
+    friend void zbus_published(const zbus_channel *chan);
+};
+
+} // namespace ble_utils::gatt
@@ -13,16 +13,20 @@
 ********************************************************************/
 #include <zephyr/bluetooth/conn.h>
 #include <zephyr/logging/log.h>
+#include <ble_utils/adv.hpp>
+#include <ble_utils/conn_tuning.hpp>
 #include "ble.hpp"
+#include "uptime_service.hpp"
 LOG_MODULE_REGISTER(ble, CONFIG_LOG_DEFAULT_LEVEL);
 
 namespace ble
 {
 
-constexpr size_t MAX_SD_SIZE {5U};
-static size_t sd_cnt = 0;
+/* Services advertised in the scan response, packed at compile time */
+using scan_rsp = ble_utils::adv::ServiceUuids<ble_utils::adv::Payload::Legacy,
+											true,
+											uptime::uuid::svc_base>;
 
-static struct bt_data sd_data[MAX_SD_SIZE] = {};
 static constexpr bt_le_adv_param adv_param = BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_CONNECTABLE |
 																		BT_LE_ADV_OPT_USE_NAME,
 																	BT_GAP_ADV_FAST_INT_MIN_2,
@@ -75,8 +79,8 @@ static int start_adv(void)
  	int err = bt_le_adv_start(&adv_param,
                                 adv_data,
                                 ARRAY_SIZE(adv_data),
-                                sd_data,
-                                sd_cnt);
+                                scan_rsp::data(),
+                                scan_rsp::count);
 
 	if (err) {
 		LOG_ERR("Failed to create advertiser set (err %d)", err);
@@ -85,43 +89,6 @@ static int start_adv(void)
 	return 0;
 }
 
-bool register_svc_to_scan_rsp(const bt_uuid *uuid)
-{
-	uint8_t data_len;
-	const uint8_t * p_data;
-	uint8_t adv_type;
-	switch(uuid->type){
-		case BT_UUID_TYPE_16:
-			data_len = 2;
-			adv_type = BT_DATA_UUID16_SOME;
-			p_data = (const uint8_t *)&((bt_uuid_16 *)uuid)->val;
-			break;
-		case BT_UUID_TYPE_32:
-			data_len = 4;
-			adv_type = BT_DATA_UUID32_SOME;
-			p_data = (const uint8_t *)&((bt_uuid_32 *)uuid)->val;
-			break;
-		case BT_UUID_TYPE_128:
-			data_len = 16;
-			adv_type = BT_DATA_UUID128_SOME;
-			p_data = (const uint8_t *)&((bt_uuid_128 *)uuid)->val[0];
-			break;
-		default:
-			return false;
-	}
-
-	if (sd_cnt < MAX_SD_SIZE) {
-		bt_data data = {.
-			type = adv_type,
-			.data_len = data_len,
-			.data = p_data
-		};
-		sd_data[sd_cnt++] = data;
-		return true;
-	}
-	return false;
-}
-
 int init()
 {
   	int err;
@@ -135,6 +102,12 @@ int init()
 		}
 
 		LOG_INF("Bluetooth initialized\n");
+		err = ble_utils::conn::init(ble_utils::conn::profile::throughput);
+		if (err)
+		{
+			LOG_ERR("Connection tuning failed to init (err %d)", err);
+			break;
+		}
 		err = start_adv();
 		if (err)
 		{
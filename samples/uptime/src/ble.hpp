@@ -22,14 +22,4 @@ namespace ble
  */
 int init();
 
-/**
- * @brief Registers a service to the scan response message
- * when advertising.
- *
- * @param uuid The 128 bit uuid of the service.
- * @return true on success.
- * @return false when the maximum number of configurable services is reached.
- */
-bool register_svc_to_scan_rsp(const bt_uuid *uuid);
-
 } // namespace ble
@@ -23,8 +23,11 @@ uptime::Service uptime_service;
 int main(void)
 {
 	LOG_INF("Starting Uptime BLE Utils sample");
-	uptime_service.init();
-	ble::register_svc_to_scan_rsp(uptime_service.get_uuid());
+	const int err = uptime_service.init();
+	if (err) {
+		LOG_ERR("Uptime service failed to init (err %d)", err);
+		return err;
+	}
 	ble::init();
 	for (;;) {
 		const uint32_t uptime_ms = k_uptime_get_32();
@@ -56,6 +56,16 @@ void Notify::ccc_changed(CCCValue_e value)
     LOG_INF("Characteristic Notify Uptime CCC changed %d\n",val);
 }
 
+void Notify::link_updated(bt_conn *conn, const ble_utils::conn::LinkParams &params)
+{
+    ARG_UNUSED(conn);
+    LOG_INF("Link updated: MTU %u, payload %u, interval %u, PHY %u",
+            params.att_mtu,
+            params.att_payload(),
+            params.interval,
+            params.tx_phy);
+}
+
 Indicate::Indicate():
     ble_utils::gatt::CharacteristicIndicate((const bt_uuid*)&uuid::char_indicate)    
 {
@@ -71,14 +81,31 @@ void Indicate::indicate_rsp()
     LOG_INF("Characteristic Indicate Uptime Completed\n");
 }
 
+Write::Write():
+    ble_utils::gatt::Characteristic((const bt_uuid*)&uuid::char_write,
+                                    BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+                                    BT_GATT_PERM_WRITE)
+{
+}
+
+ssize_t Write::write_cb(const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+    ARG_UNUSED(buf);
+    ARG_UNUSED(offset);
+    ARG_UNUSED(flags);
+    return len;
+}
+
 } // namespace characteristic
 
 Service::Service():
-    ble_utils::gatt::Service((const bt_uuid*)&uuid::svc_base)
+    ble_utils::gatt::Service((const bt_uuid*)&uuid::svc_base, handle::svc_start, handle::svc_end)
 {
     register_char(&m_basic);
     register_char(&m_indicate);
     register_char(&m_notify);
+    register_char(&m_write);
+    ble_utils::conn::register_listener(&m_notify);
 }
 
 void Service::update(uint32_t uptime)
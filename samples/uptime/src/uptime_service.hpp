@@ -15,6 +15,7 @@
 #pragma once
 #include <ble_utils/ble_utils.hpp>
 #include <ble_utils/uuid.hpp>
+#include <ble_utils/conn_tuning.hpp>
 
 
 namespace uptime
@@ -31,6 +32,14 @@ namespace uuid
     static constexpr bt_uuid_128 char_basic = ble_utils::uuid::derive_uuid(svc_base,0x0001);
     static constexpr bt_uuid_128 char_notify = ble_utils::uuid::derive_uuid(svc_base,0x0002);
     static constexpr bt_uuid_128 char_indicate = ble_utils::uuid::derive_uuid(svc_base,0x0003);
+    static constexpr bt_uuid_128 char_write = ble_utils::uuid::derive_uuid(svc_base,0x0004);
+}
+
+/*! Fixed handle range of the service, keeps the handles cached by bonded clients valid */
+namespace handle
+{
+    static constexpr uint16_t svc_start = 0x0020;
+    static constexpr uint16_t svc_end = 0x003F;
 }
 
 namespace characteristic
@@ -46,12 +55,14 @@ private:
     uint32_t m_uptime{0};
 };
 
-class Notify final: public ble_utils::gatt::CharacteristicNotify
+class Notify final: public ble_utils::gatt::CharacteristicNotify,
+                    public ble_utils::conn::ILinkListener
 {
 public:
     Notify();
 private:
     void ccc_changed(CCCValue_e value) override;
+    void link_updated(bt_conn *conn, const ble_utils::conn::LinkParams &params) override;
 };
 
 class Indicate final: public ble_utils::gatt::CharacteristicIndicate
@@ -63,6 +74,15 @@ private:
     void indicate_rsp();
 };
 
+/*! Write sink for the load generator of the central tester, discards the data */
+class Write final: public ble_utils::gatt::Characteristic
+{
+public:
+    Write();
+private:
+    ssize_t write_cb(const void *buf, uint16_t len, uint16_t offset, uint8_t flags) override;
+};
+
 }
 
 class Service: public ble_utils::gatt::Service
@@ -74,6 +94,7 @@ class Service: public ble_utils::gatt::Service
         characteristic::Basic m_basic;
         characteristic::Indicate m_indicate;
         characteristic::Notify m_notify;   
+        characteristic::Write m_write;
 };
 
 } // namespace uptime
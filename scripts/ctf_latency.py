@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+# Copyright 2024 Victor Chavez
+# SPDX-License-Identifier: Apache-2.0
+"""
+Latency histograms of the ble_utils GATT trace events.
+
+Reads a CTF trace recorded with CONFIG_BLE_UTILS_TRACING and pairs the
+named events:
+
+- bleu_read_enter    -> bleu_read_exit
+- bleu_write_enter   -> bleu_write_exit
+- bleu_notify_submit -> bleu_notify_done
+- bleu_ind_submit    -> bleu_ind_confirm
+
+Reads and writes are paired in order per characteristic. Notifications and
+indications are paired by their sequence number, a value sent to several
+connections completes once per connection.
+
+For each pair a log2 histogram of the latency in microseconds is printed,
+notifications and indications per connection.
+The connection parameters requested by the adaptive controller
+(bleu_conn_param, CONFIG_BLE_UTILS_CONN_ADAPTIVE) are printed as a timeline.
+
+Requires the babeltrace2 Python bindings (bt2).
+"""
+
+import argparse
+import collections
+import sys
+
+try:
+    import bt2
+except ImportError:
+    sys.exit("babeltrace2 python bindings (bt2) are required")
+
+# Keep in sync with src/trace.hpp
+PAIRS = {
+    "bleu_read_enter": ("read", True),
+    "bleu_read_exit": ("read", False),
+    "bleu_write_enter": ("write", True),
+    "bleu_write_exit": ("write", False),
+    "bleu_notify_submit": ("notify", True),
+    "bleu_notify_done": ("notify", False),
+    "bleu_ind_submit": ("indicate", True),
+    "bleu_ind_confirm": ("indicate", False),
+}
+# Operations whose events carry a sequence number
+SEQUENCED = ("notify", "indicate")
+# A batch to several connections submits the same sequence number per connection
+SEQ_REPEAT_NS = 1_000_000_000
+NO_CONN = 0xFF
+CCC_CHANGED = "bleu_ccc_changed"
+CONN_PARAM = "bleu_conn_param"
+
+
+def histogram_bucket(latency_us):
+    """Index of the log2 bucket of a latency"""
+    return max(int(latency_us), 1).bit_length() - 1
+
+
+def print_histogram(op, chrc_id, conn, latencies):
+    buckets = collections.Counter(histogram_bucket(lat) for lat in latencies)
+    avg = sum(latencies) / len(latencies)
+    conn_str = "" if conn is None else f" conn {'-' if conn == NO_CONN else conn}"
+    print(f"{op} 0x{chrc_id:08x}{conn_str}: count {len(latencies)} "
+          f"min {min(latencies):.1f} avg {avg:.1f} max {max(latencies):.1f} us")
+    peak = max(buckets.values())
+    for bucket in range(min(buckets), max(buckets) + 1):
+        count = buckets.get(bucket, 0)
+        bar = "#" * ((count * 40 + peak - 1) // peak)
+        print(f"  {1 << bucket:>8} - {(1 << (bucket + 1)) - 1:<8} us | {count:>6} {bar}")
+
+
+def print_conn_params(conn_params):
+    # arg0: connection index << 16 | max. interval, arg1: latency << 16 | backlog
+    print("Requested connection parameters")
+    start_ns = conn_params[0][0]
+    for timestamp_ns, arg0, arg1 in conn_params:
+        print(f"  {(timestamp_ns - start_ns) / 1e6:>10.1f} ms conn {arg0 >> 16}: "
+              f"interval {(arg0 & 0xFFFF) * 1.25:.2f} ms, latency {arg1 >> 16}, "
+              f"backlog {arg1 & 0xFFFF}")
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("trace", help="Directory with the CTF trace and its metadata")
+    args = parser.parse_args()
+
+    # Pending start timestamps of reads and writes per (operation, characteristic)
+    pending = collections.defaultdict(collections.deque)
+    # Submits of notifications and indications per (operation, sequence number)
+    # as [timestamp, characteristic, completed]
+    submits = {}
+    # Completions traced before their submit per (operation, sequence number)
+    early = collections.defaultdict(list)
+    latencies = collections.defaultdict(list)
+    unmatched = 0
+    ccc_changes = 0
+    conn_params = []
+
+    for msg in bt2.TraceCollectionMessageIterator(args.trace):
+        if type(msg) is not bt2._EventMessageConst:
+            continue
+        event = msg.event
+        if event.name != "named_event":
+            continue
+        name = str(event.payload_field["name"])
+        chrc_id = int(event.payload_field["arg0"])
+        if name == CCC_CHANGED:
+            ccc_changes += 1
+            continue
+        if name == CONN_PARAM:
+            conn_params.append((msg.default_clock_snapshot.ns_from_origin, chrc_id,
+                                int(event.payload_field["arg1"])))
+            continue
+        if name not in PAIRS:
+            continue
+        op, is_start = PAIRS[name]
+        timestamp_ns = msg.default_clock_snapshot.ns_from_origin
+        arg1 = int(event.payload_field["arg1"])
+        if op in SEQUENCED:
+            # submit: arg0 characteristic, arg1 sequence << 16 | length
+            # completion: arg0 sequence, arg1 connection index
+            seq = arg1 >> 16 if is_start else chrc_id & 0xFFFF
+            key = (op, seq)
+            if is_start:
+                prev = submits.get(key)
+                if (prev is None or prev[1] != chrc_id or
+                        timestamp_ns - prev[0] >= SEQ_REPEAT_NS):
+                    submits[key] = [timestamp_ns, chrc_id, False]
+                submit = submits[key]
+                for done_ns, conn in early.pop(key, []):
+                    # Emitted after the send, the completion may be traced first
+                    latencies[(op, chrc_id, conn)].append(max(done_ns - submit[0], 0) / 1000.0)
+                    submit[2] = True
+            elif key in submits:
+                submit = submits[key]
+                latencies[(op, submit[1], arg1)].append((timestamp_ns - submit[0]) / 1000.0)
+                submit[2] = True
+            else:
+                early[key].append((timestamp_ns, arg1))
+            continue
+        key = (op, chrc_id, None)
+        if is_start:
+            pending[key].append(timestamp_ns)
+        elif pending[key]:
+            latencies[key].append((timestamp_ns - pending[key].popleft()) / 1000.0)
+        else:
+            unmatched += 1
+
+    if conn_params:
+        print_conn_params(conn_params)
+    if not latencies:
+        print("No ble_utils events found")
+        return
+    for (op, chrc_id, conn), values in sorted(latencies.items(), key=lambda item: (
+            item[0][0], item[0][1], -1 if item[0][2] is None else item[0][2])):
+        print_histogram(op, chrc_id, conn, values)
+    unmatched += sum(len(done) for done in early.values())
+    outstanding = sum(len(queue) for queue in pending.values())
+    outstanding += sum(1 for submit in submits.values() if not submit[2])
+    print(f"CCC changes: {ccc_changes}, unmatched completions: {unmatched}, "
+          f"outstanding: {outstanding}")
+
+
+if __name__ == "__main__":
+    main()
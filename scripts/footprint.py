@@ -0,0 +1,301 @@
+#!/usr/bin/env python3
+# Copyright 2024 Victor Chavez
+# SPDX-License-Identifier: Apache-2.0
+"""
+Footprint regression suite of ble_utils.
+
+Builds tests/footprint once per variant of tests/footprint/budgets.json with
+N plain, notify and indicate characteristics spread over M services, then
+measures from the ELF and the linker map:
+
+- image ROM/RAM and the delta to the first variant
+- ROM/RAM of every object of libble_utils.a
+- RAM per instance of each characteristic type and of a service
+- ROM of the ble_utils vtables
+
+The results are written as JSON and compared to the budgets of each variant,
+the exit code is 1 if a budget is exceeded. --update-budgets replaces the
+budgets with the measured values plus the margin of the budgets file. A
+variant without budgets is only reported, its budgets have to be measured
+with --update-budgets on the toolchain of the CI.
+
+Run it from a west workspace. Requires pyelftools (zephyr requirements).
+"""
+
+import argparse
+import json
+import math
+import re
+import subprocess
+import sys
+from pathlib import Path
+
+try:
+    from elftools.elf.elffile import ELFFile
+    from elftools.elf.constants import SH_FLAGS
+except ImportError:
+    sys.exit("pyelftools is required")
+
+ROOT = Path(__file__).resolve().parent.parent
+APP = ROOT / "tests" / "footprint"
+BUDGETS = APP / "budgets.json"
+LIB_ARCHIVE = "libble_utils.a("
+VTABLE_PREFIX = "_ZTVN9ble_utils"
+
+# Keep in sync with tests/footprint/src/main.cpp
+TYPES = ("plain", "notify", "indicate")
+SYMBOLS = {
+    "plain": "footprint_plain",
+    "notify": "footprint_notify",
+    "indicate": "footprint_indicate",
+    "service": "footprint_services",
+}
+# Attributes of a service declaration and of each characteristic type
+SVC_ATTRS = 1
+ATTRS = {"plain": 2, "notify": 3, "indicate": 3}
+# Range of CONFIG_BLE_UTILS_MAX_ATTR
+MAX_ATTR_LIMIT = 30
+
+
+def max_attr(variant):
+    """Attributes of the largest service, main.cpp registers round robin."""
+    per_svc = [SVC_ATTRS] * variant["services"]
+    idx = 0
+    for kind in TYPES:
+        for _ in range(variant.get(kind, 0)):
+            per_svc[idx % variant["services"]] += ATTRS[kind]
+            idx += 1
+    return max(per_svc)
+
+
+def build(variant, board, build_dir, attrs):
+    cmd = [
+        "west", "build", "-p", "always", "-b", board,
+        "-d", str(build_dir), str(APP), "--",
+        f"-DFOOTPRINT_SERVICES={variant['services']}",
+        f"-DCONFIG_BLE_UTILS_MAX_ATTR={attrs}",
+    ]
+    cmd += [f"-DFOOTPRINT_{kind.upper()}={variant.get(kind, 0)}" for kind in TYPES]
+    subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+
+
+def demangle_vtable(name):
+    """Class name of a vtable symbol with a nested name, e.g. _ZTVN9ble_utils4gatt4NameE."""
+    parts = []
+    pos = len("_ZTVN")
+    while pos < len(name) and name[pos].isdigit():
+        m = re.match(r"\d+", name[pos:])
+        length = int(m.group(0))
+        pos += len(m.group(0))
+        parts.append(name[pos:pos + length])
+        pos += length
+    return "::".join(parts) if parts else name
+
+
+def section_classes(elf):
+    """ROM and RAM usage of the allocated sections, by section name."""
+    classes = {}
+    for section in elf.iter_sections():
+        flags = section["sh_flags"]
+        if not flags & SH_FLAGS.SHF_ALLOC:
+            continue
+        rom = section["sh_type"] != "SHT_NOBITS"
+        ram = bool(flags & SH_FLAGS.SHF_WRITE)
+        classes[section.name] = (rom, ram)
+    return classes
+
+
+def measure_elf(elf_path):
+    with open(elf_path, "rb") as f:
+        elf = ELFFile(f)
+        classes = section_classes(elf)
+        image = {"rom": 0, "ram": 0}
+        for section in elf.iter_sections():
+            if section.name not in classes:
+                continue
+            rom, ram = classes[section.name]
+            image["rom"] += section["sh_size"] if rom else 0
+            image["ram"] += section["sh_size"] if ram else 0
+        symbols = {}
+        vtables = {}
+        symtab = elf.get_section_by_name(".symtab")
+        for sym in symtab.iter_symbols():
+            if sym.name in SYMBOLS.values():
+                symbols[sym.name] = sym["st_size"]
+            elif sym.name.startswith(VTABLE_PREFIX) and sym["st_size"]:
+                vtables[demangle_vtable(sym.name)] = sym["st_size"]
+    return classes, image, symbols, vtables
+
+
+def measure_map(map_path, classes):
+    """ROM and RAM of each libble_utils.a object from the linker map."""
+    objects = {}
+    out_section = None
+    pending = None
+    started = False
+    input_re = re.compile(r"^\s+(?:(\S+)\s+)?0x[0-9a-fA-F]+\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+    with open(map_path) as f:
+        for line in f:
+            if not started:
+                started = line.startswith("Linker script and memory map")
+                continue
+            if line[:1] not in (" ", "\n", ""):
+                out_section = line.split()[0]
+                pending = None
+                continue
+            m = input_re.match(line.rstrip("\n"))
+            if m is None:
+                # Long input section names are on their own line
+                tokens = line.split()
+                pending = tokens[0] if len(tokens) == 1 and not tokens[0].startswith("*") else None
+                continue
+            name = m.group(1) or pending
+            pending = None
+            src = m.group(3).strip()
+            if name is None or LIB_ARCHIVE not in src or out_section not in classes:
+                continue
+            obj = src[src.index(LIB_ARCHIVE) + len(LIB_ARCHIVE):].rstrip(")")
+            size = int(m.group(2), 16)
+            rom, ram = classes[out_section]
+            entry = objects.setdefault(obj, {"rom": 0, "ram": 0})
+            entry["rom"] += size if rom else 0
+            entry["ram"] += size if ram else 0
+    return objects
+
+
+def measure(variant, build_dir, attrs):
+    zephyr_dir = build_dir / "zephyr"
+    classes, image, symbols, vtables = measure_elf(zephyr_dir / "zephyr.elf")
+    objects = measure_map(zephyr_dir / "zephyr.map", classes)
+    instances = {}
+    for kind, symbol in SYMBOLS.items():
+        count = variant["services"] if kind == "service" else variant.get(kind, 0)
+        if count and symbol in symbols:
+            instances[kind] = {"count": count, "ram": symbols[symbol] // count}
+    return {
+        "name": variant["name"],
+        "config": {kind: variant.get(kind, 0) for kind in TYPES},
+        "services": variant["services"],
+        "max_attr": attrs,
+        "image": image,
+        "objects": objects,
+        "library": {
+            "rom": sum(obj["rom"] for obj in objects.values()),
+            "ram": sum(obj["ram"] for obj in objects.values()),
+        },
+        "instances": instances,
+        "vtables": vtables,
+        "vtable_rom": sum(vtables.values()),
+    }
+
+
+def metrics(result):
+    """Flat view of the measured values that have budgets."""
+    values = {
+        "library_rom": result["library"]["rom"],
+        "library_ram": result["library"]["ram"],
+        "vtable_rom": result["vtable_rom"],
+    }
+    for kind, inst in result["instances"].items():
+        values[f"instance_ram.{kind}"] = inst["ram"]
+    return values
+
+
+def flat_budget(budget):
+    values = {k: v for k, v in budget.items() if k != "instance_ram"}
+    for kind, ram in budget.get("instance_ram", {}).items():
+        values[f"instance_ram.{kind}"] = ram
+    return values
+
+
+def check(result, budget):
+    """Print the budget table of a variant, return the exceeded metrics."""
+    exceeded = []
+    budget = flat_budget(budget)
+    for metric, value in metrics(result).items():
+        limit = budget.get(metric)
+        if limit is None:
+            status = "-"
+        elif value > limit:
+            status = "OVER"
+            exceeded.append(f"{result['name']}: {metric} {value} > {limit}")
+        else:
+            status = "ok"
+        limit_str = "-" if limit is None else str(limit)
+        print(f"{result['name']:<10} {metric:<24} {value:>8} {limit_str:>8}  {status}")
+    return exceeded
+
+
+def updated_budget(result, margin):
+    values = metrics(result)
+    budget = {}
+    for metric, value in values.items():
+        limit = math.ceil(value * (1.0 + margin))
+        if metric.startswith("instance_ram."):
+            budget.setdefault("instance_ram", {})[metric.split(".", 1)[1]] = limit
+        else:
+            budget[metric] = limit
+    return budget
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--budgets", type=Path, default=BUDGETS,
+                        help="variants and budgets (default: %(default)s)")
+    parser.add_argument("--board", help="board to build for, overrides the budgets file")
+    parser.add_argument("--build-dir", type=Path, default=Path("build_footprint"),
+                        help="directory of the variant builds")
+    parser.add_argument("--output", type=Path, default=Path("footprint.json"),
+                        help="machine readable results")
+    parser.add_argument("--no-build", action="store_true",
+                        help="measure existing builds")
+    parser.add_argument("--update-budgets", action="store_true",
+                        help="write the measured values plus margin as new budgets")
+    args = parser.parse_args()
+
+    with open(args.budgets) as f:
+        config = json.load(f)
+    board = args.board or config["board"]
+
+    results = []
+    for variant in config["variants"]:
+        attrs = max_attr(variant)
+        if attrs > MAX_ATTR_LIMIT:
+            sys.exit(f"{variant['name']}: {attrs} attributes per service exceed "
+                     f"CONFIG_BLE_UTILS_MAX_ATTR ({MAX_ATTR_LIMIT})")
+        build_dir = args.build_dir / variant["name"]
+        if not args.no_build:
+            print(f"Building {variant['name']} ({attrs} attributes per service)", file=sys.stderr)
+            build(variant, board, build_dir, attrs)
+        results.append(measure(variant, build_dir, attrs))
+
+    base = results[0]["image"]
+    for result in results:
+        result["delta"] = {key: result["image"][key] - base[key] for key in base}
+
+    with open(args.output, "w") as f:
+        json.dump({"board": board, "variants": results}, f, indent=2)
+
+    print(f"{'variant':<10} {'metric':<24} {'measured':>8} {'budget':>8}")
+    exceeded = []
+    for variant, result in zip(config["variants"], results):
+        exceeded += check(result, variant.get("budget", {}))
+        if "budget" not in variant and not args.update_budgets:
+            print(f"{variant['name']}: no budget, measure it with --update-budgets", file=sys.stderr)
+
+    if args.update_budgets:
+        for variant, result in zip(config["variants"], results):
+            variant["budget"] = updated_budget(result, config.get("margin", 0.0))
+        with open(args.budgets, "w") as f:
+            json.dump(config, f, indent=2)
+            f.write("\n")
+        print(f"Budgets updated in {args.budgets}")
+        return 0
+
+    for line in exceeded:
+        print(f"Budget exceeded: {line}", file=sys.stderr)
+    return 1 if exceeded else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
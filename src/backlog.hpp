@@ -0,0 +1,69 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file backlog.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Internal hooks that count per connection the notifications and indications
+* the host accepted and did not complete yet. They are the load signal of
+* the adaptive connection parameters, see conn_tuning.cpp.
+********************************************************************/
+
+#pragma once
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/sys/util.h>
+#include <stdint.h>
+
+namespace ble_utils::conn::backlog
+{
+
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+/**
+ * @brief A notification or indication to a connection was accepted by the host
+ *
+ * @param conn Connection the value is sent to
+ * @param len Length of the value
+ */
+void submitted(bt_conn *conn, uint16_t len);
+
+/**
+ * @brief A notification or indication to all connections was accepted by the host
+ * @details Counted for every connection that is subscribed to the attribute.
+ *
+ * @param attr Registered value attribute
+ * @param type BT_GATT_CCC_NOTIFY or BT_GATT_CCC_INDICATE
+ * @param len Length of the value
+ */
+void submitted(const bt_gatt_attr *attr, uint16_t type, uint16_t len);
+
+/**
+ * @brief A notification was sent or an indication was confirmed
+ * @details The backlog of a connection does not go below zero.
+ *
+ * @param conn Connection the value was sent to
+ */
+void completed(bt_conn *conn);
+#else
+static inline void submitted(bt_conn *conn, uint16_t len)
+{
+    ARG_UNUSED(conn);
+    ARG_UNUSED(len);
+}
+
+static inline void submitted(const bt_gatt_attr *attr, uint16_t type, uint16_t len)
+{
+    ARG_UNUSED(attr);
+    ARG_UNUSED(type);
+    ARG_UNUSED(len);
+}
+
+static inline void completed(bt_conn *conn)
+{
+    ARG_UNUSED(conn);
+}
+#endif
+
+} // namespace ble_utils::conn::backlog
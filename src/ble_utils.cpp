@@ -6,6 +6,13 @@
 ********************************************************************/
 
 #include <ble_utils/ble_utils.hpp>
+#include "trace.hpp"
+#include "backlog.hpp"
+#include <string.h>
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+#include "ccc.hpp"
+#include <zephyr/sys/byteorder.h>
+#endif
 
 namespace ble_utils::gatt
 {
@@ -16,6 +23,8 @@ namespace ble_utils::gatt
 namespace uuid
 {
 static constexpr bt_uuid_16 PRIMARY_SVC = BT_UUID_INIT_16(BT_UUID_GATT_PRIMARY_VAL);
+static constexpr bt_uuid_16 SECONDARY_SVC = BT_UUID_INIT_16(BT_UUID_GATT_SECONDARY_VAL);
+static constexpr bt_uuid_16 INCLUDE_SVC = BT_UUID_INIT_16(BT_UUID_GATT_INCLUDE_VAL);
 static constexpr bt_uuid_16 CHRC_VAL = BT_UUID_INIT_16(BT_UUID_GATT_CHRC_VAL);
 static constexpr bt_uuid_16 CHRC_CCC = BT_UUID_INIT_16(BT_UUID_GATT_CCC_VAL); 
 } // namespace uuid
@@ -65,9 +74,11 @@ ssize_t Characteristic::_read_cb(struct bt_conn *conn,
                     void *buf, uint16_t len,
                     uint16_t offset)
 {
-    ARG_UNUSED(conn);
     auto instance = static_cast<Characteristic *>(attr->user_data);
-    return instance->read_cb(buf, len, offset);
+    trace::emit(trace::event::READ_ENTER, attr->uuid, offset);
+    const ssize_t res = instance->conn_read_cb(conn, buf, len, offset);
+    trace::emit(trace::event::READ_EXIT, attr->uuid, static_cast<uint32_t>(res));
+    return res;
 }
 ssize_t Characteristic::_write_cb(struct bt_conn *conn,
                             const struct bt_gatt_attr *attr,
@@ -76,12 +87,22 @@ ssize_t Characteristic::_write_cb(struct bt_conn *conn,
                             uint16_t offset,
                             uint8_t flags)
 {
-    ARG_UNUSED(conn);
     auto instance = static_cast<Characteristic *>(attr->user_data);
-    return instance->write_cb(buf, len, offset, flags);
+    trace::emit(trace::event::WRITE_ENTER, attr->uuid, len);
+    const ssize_t res = instance->conn_write_cb(conn, buf, len, offset, flags);
+    trace::emit(trace::event::WRITE_EXIT, attr->uuid, static_cast<uint32_t>(res));
+    return res;
 }
 
 Service::Service(const bt_uuid *uuid):
+    Service(uuid, 0, 0){}
+
+Service::Service(const bt_uuid *uuid, uint16_t start_handle, uint16_t end_handle):
+    Service(uuid, start_handle, end_handle, true){}
+
+Service::Service(const bt_uuid *uuid, uint16_t start_handle, uint16_t end_handle, bool primary):
+    m_start_handle(start_handle),
+    m_end_handle(end_handle),
     m_gatt_service
     (
         {
@@ -91,8 +112,10 @@ Service::Service(const bt_uuid *uuid):
         }
     )
 {
+    __ASSERT(start_handle <= end_handle, "Invalid handle range");
+    const bt_uuid_16 *svc_uuid = primary ? &uuid::PRIMARY_SVC : &uuid::SECONDARY_SVC;
     const bt_gatt_attr svc_attr = {
-        .uuid = static_cast<const bt_uuid *>(static_cast<const void *>(&uuid::PRIMARY_SVC)),
+        .uuid = static_cast<const bt_uuid *>(static_cast<const void *>(svc_uuid)),
         .read = bt_gatt_attr_read_service,
         .write = nullptr,
         .user_data = static_cast<void *>(const_cast<bt_uuid *>(uuid)),
@@ -102,26 +125,250 @@ Service::Service(const bt_uuid *uuid):
     attrs[0] = svc_attr;
 }
 
+SecondaryService::SecondaryService(const bt_uuid *uuid):
+    SecondaryService(uuid, 0, 0){}
+
+SecondaryService::SecondaryService(const bt_uuid *uuid, uint16_t start_handle, uint16_t end_handle):
+    Service(uuid, start_handle, end_handle, false){}
+
 void Service::register_char(const Characteristic * chrc)
 {
     const uint8_t chrc_attr_size  = chrc->m_ccc_enable ? 
                                     ICharacteristicCCC::attr_size
                                     : Characteristic::attr_size;
     const auto req_size{m_gatt_service.attr_count + chrc_attr_size};
-    ARG_UNUSED(req_size);
     __ASSERT(req_size <= MAX_ATTR, "Max. attribute size reached");
+    if (req_size > MAX_ATTR) {
+        /* Asserts are usually disabled, init fails instead of corrupting the service */
+        m_attr_overflow = true;
+        return;
+    }
     attrs[m_gatt_service.attr_count++] = chrc->m_attr;
     attrs[m_gatt_service.attr_count++] = chrc->m_attr_value;
     if (chrc->m_ccc_enable) {
         auto char_ccc = static_cast<const ICharacteristicCCC*>(chrc);
+        char_ccc->m_value_attr = &attrs[m_gatt_service.attr_count - 1U];
         attrs[m_gatt_service.attr_count++] = char_ccc->m_ccc_attr;
     }
 }
 
+void Service::include(Service & svc)
+{
+    __ASSERT(m_gatt_service.attr_count == static_cast<size_t>(SVC_ATTR_SIZE + m_include_cnt),
+             "Included services must be added before the characteristics");
+    __ASSERT(m_gatt_service.attr_count < MAX_ATTR, "Max. attribute size reached");
+    if (m_gatt_service.attr_count >= MAX_ATTR) {
+        m_attr_overflow = true;
+        return;
+    }
+    /* The include definition refers to the service declaration that is registered */
+    const bt_gatt_attr incl_attr = {
+        .uuid = static_cast<const bt_uuid *>(static_cast<const void *>(&uuid::INCLUDE_SVC)),
+        .read = bt_gatt_attr_read_included,
+        .write = nullptr,
+        .user_data = &svc.attrs[0],
+        .handle = 0,
+        .perm = BT_GATT_PERM_READ
+    };
+    attrs[m_gatt_service.attr_count++] = incl_attr;
+    m_include_cnt++;
+}
+
+void Service::register_char(const Characteristic * chrc, uint16_t handle)
+{
+    const size_t chrc_idx = m_gatt_service.attr_count;
+    register_char(chrc);
+    if (chrc_idx < m_gatt_service.attr_count) {
+        attrs[chrc_idx].handle = handle;
+    }
+}
+
+#if defined(CONFIG_BLE_UTILS_NOTIFY_BATCH)
+void Service::begin_batch()
+{
+    m_batch_cnt = 0;
+}
+
+int Service::batch_notify(CharacteristicNotify & chrc, const void * data, const uint16_t len)
+{
+    if (m_batch_cnt >= BATCH_MAX) {
+        return -ENOMEM;
+    }
+    /* A multiple notification is sent by the handle of the registered value attribute */
+    const bt_gatt_attr *value_attr = chrc.m_value_attr;
+    if (value_attr == nullptr) {
+        return -EINVAL;
+    }
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+    m_batch_ccc[m_batch_cnt] = chrc.m_ccc_idx;
+#endif
+    bt_gatt_notify_params &params = m_batch[m_batch_cnt++];
+    chrc.prepare(params, data, len);
+    params.uuid = nullptr;
+    params.attr = value_attr;
+    return 0;
+}
+
+/**
+ * @brief Context of a batch to all connections
+ */
+struct BatchCtx
+{
+    const bt_gatt_notify_params *params;
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+    const uint16_t *ccc;
+#endif
+    /*! Notifications a connection subscribed to */
+    bt_gatt_notify_params *send;
+    uint16_t cnt;
+    int err;
+};
+
+static void batch_result(int &result, int err)
+{
+    /* Keep the first error, -ENOTCONN only if nothing was sent */
+    if (result == -ENOTCONN || result == 0) {
+        result = err;
+    }
+}
+
+static void commit_conn(bt_conn *conn, void *data)
+{
+    auto ctx = static_cast<BatchCtx *>(data);
+    bt_gatt_notify_params *send = ctx->send;
+    uint16_t cnt = 0;
+    for (uint16_t i = 0; i < ctx->cnt; i++) {
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+        const bool subscribed = CCCTable::match(conn, ctx->ccc[i], BT_GATT_CCC_NOTIFY);
+#else
+        const bool subscribed = bt_gatt_is_subscribed(conn, ctx->params[i].attr, BT_GATT_CCC_NOTIFY);
+#endif
+        if (subscribed) {
+            send[cnt++] = ctx->params[i];
+        }
+    }
+    if (cnt == 0) {
+        return;
+    }
+#if defined(CONFIG_BT_GATT_NOTIFY_MULTIPLE)
+    /* The host rejects a multiple notification with a single value */
+    if (cnt >= 2) {
+        /* All values share the callback, it completes the sequence number of each */
+        const uint16_t seq = trace::next_seq(cnt);
+        for (uint16_t i = 0; i < cnt; i++) {
+            send[i].user_data = trace::seq_data(seq, cnt);
+        }
+        const int err = bt_gatt_notify_multiple(conn, cnt, send);
+        if (err == 0) {
+            /* A multiple handle notification only completes once */
+            uint16_t len = 0;
+            for (uint16_t i = 0; i < cnt; i++) {
+                len += send[i].len;
+                trace::emit_submit(trace::event::NOTIFY_SUBMIT, send[i].attr->uuid,
+                                   seq + i, send[i].len);
+            }
+            conn::backlog::submitted(conn, len);
+        }
+        if (err != -EOPNOTSUPP) {
+            batch_result(ctx->err, err);
+            return;
+        }
+        /* The peer does not support multiple notifications, send them one by one */
+        for (uint16_t i = 0; i < cnt; i++) {
+            send[i].user_data = trace::seq_data(seq + i);
+        }
+    }
+#endif
+    for (uint16_t i = 0; i < cnt; i++) {
+        const int err = bt_gatt_notify_cb(conn, &send[i]);
+        if (err == 0) {
+            trace::emit_submit(trace::event::NOTIFY_SUBMIT, send[i].attr->uuid,
+                               trace::seq_of(send[i].user_data), send[i].len);
+            conn::backlog::submitted(conn, send[i].len);
+        }
+        batch_result(ctx->err, err);
+    }
+}
+
+int Service::commit()
+{
+    const uint16_t cnt = m_batch_cnt;
+    m_batch_cnt = 0;
+    if (cnt == 0) {
+        return 0;
+    }
+    /* Multiple notifications are per connection, peers without support get single ones */
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+    BatchCtx ctx{m_batch, m_batch_ccc, m_batch_conn, cnt, -ENOTCONN};
+#else
+    BatchCtx ctx{m_batch, m_batch_conn, cnt, -ENOTCONN};
+#endif
+    bt_conn_foreach(BT_CONN_TYPE_LE, commit_conn, &ctx);
+#if defined(CONFIG_BLE_UTILS_BROADCAST)
+    for (uint16_t i = 0; i < cnt; i++) {
+        auto chrc = static_cast<Characteristic *>(m_batch[i].attr->user_data);
+        static_cast<CharacteristicNotify *>(chrc)->broadcast(m_batch[i].data, m_batch[i].len);
+    }
+#endif
+    return ctx.err;
+}
+#endif
+
+/*! @brief Services with a fixed handle range that were registered */
+static Service *pinned_services;
+/*! @brief Highest handle used or reserved by a registered service */
+static uint16_t last_handle;
+
+int Service::assign_handles()
+{
+    for (const Service *svc = pinned_services; svc != nullptr; svc = svc->m_next_pinned) {
+        if (m_start_handle <= svc->m_end_handle && svc->m_start_handle <= m_end_handle) {
+            return -EADDRINUSE;
+        }
+    }
+    uint16_t handle = m_start_handle;
+    attrs[0].handle = handle;
+    for (size_t i = SVC_ATTR_SIZE; i < m_gatt_service.attr_count; i++) {
+        if (attrs[i].handle == 0) {
+            attrs[i].handle = ++handle;
+        } else if (attrs[i].handle > handle) {
+            handle = attrs[i].handle;
+        } else {
+            return -EINVAL;
+        }
+    }
+    if (handle > m_end_handle) {
+        return -ENOSPC;
+    }
+    return 0;
+}
+
 int Service::init()
 {
+    if (m_attr_overflow) {
+        return -ENOMEM;
+    }
+    if (m_start_handle != 0) {
+        const int err = assign_handles();
+        if (err) {
+            return err;
+        }
+    } else if (pinned_services != nullptr) {
+        /* Zephyr appends after the last attribute, which can be in the spare room of a range */
+        attrs[0].handle = last_handle + 1U;
+    }
     const int res = bt_gatt_service_register(&m_gatt_service);
-    return res;
+    if (res != 0) {
+        return res;
+    }
+    if (m_start_handle != 0) {
+        m_next_pinned = pinned_services;
+        pinned_services = this;
+        last_handle = MAX(last_handle, m_end_handle);
+    } else {
+        last_handle = MAX(last_handle, attrs[m_gatt_service.attr_count - 1U].handle);
+    }
+    return 0;
 }
 
 const bt_uuid * Service::get_uuid()
@@ -138,22 +385,32 @@ const bt_uuid * Service::get_uuid()
  */
 ICharacteristicCCC::ICharacteristicCCC(const bt_uuid * uuid, uint8_t props, uint8_t perm):
         Characteristic(uuid, props, perm, true),
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+        m_ccc_idx(CCCTable::add(this)),
+#else
         m_ccc_data({
                     {
                     .cfg{},
                     .value{0},
                     .cfg_changed =_ccc_changed,
-                    .cfg_write = nullptr,
+                    .cfg_write = _ccc_cfg_write,
                     .cfg_match = nullptr,
                     },
                     this
                     }),
+#endif
         m_ccc_attr({
                     .uuid = static_cast<const bt_uuid *>(static_cast<const void *>(&uuid::CHRC_CCC)),
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+                    .read = _ccc_read,
+                    .write = _ccc_write,
+                    .user_data = static_cast<void *>(this),
+#else
                     .read = bt_gatt_attr_read_ccc,
                     .write = bt_gatt_attr_write_ccc,
                     .user_data =static_cast<void *>
                                     (const_cast<gatt_ccc*>(&m_ccc_data)),
+#endif
                     .handle = 0,
                     .perm = BT_GATT_PERM_READ | BT_GATT_PERM_WRITE
                     }
@@ -163,34 +420,207 @@ ICharacteristicCCC::ICharacteristicCCC(const bt_uuid * uuid, uint8_t props, uint
 
 ICharacteristicCCC::~ICharacteristicCCC() {}
 
-void ICharacteristicCCC::_ccc_changed(const bt_gatt_attr *attr, uint16_t value)
+void ICharacteristicCCC::changed(uint16_t value)
 {
-    auto ccc_data = static_cast<const gatt_ccc*>(attr->user_data);
-    auto instance = static_cast<ICharacteristicCCC*>(ccc_data->ctx);
+    trace::emit(trace::event::CCC_CHANGED, get_uuid(), value);
     if (value > BT_GATT_CCC_INDICATE) {
-        instance->ccc_changed(CCCValue_e::NA);  
+        ccc_changed(CCCValue_e::NA);  
     } else {
         const CCCValue_e ccc_value = static_cast<CCCValue_e>(value);
-        instance->ccc_changed(ccc_value);
+        ccc_changed(ccc_value);
+    }
+}
+
+void ICharacteristicCCC::written(bt_conn *conn, uint16_t value)
+{
+    if (value > BT_GATT_CCC_INDICATE) {
+        conn_ccc_written(conn, CCCValue_e::NA);
+    } else {
+        conn_ccc_written(conn, static_cast<CCCValue_e>(value));
     }
 }
 
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+bool ICharacteristicCCC::is_subscribed(const bt_conn *conn, uint16_t type) const
+{
+    return CCCTable::match(conn, m_ccc_idx, type);
+}
+
+ssize_t ICharacteristicCCC::_ccc_read(bt_conn *conn, const bt_gatt_attr *attr,
+                                      void *buf, uint16_t len, uint16_t offset)
+{
+    auto instance = static_cast<const ICharacteristicCCC*>(attr->user_data);
+    const uint16_t value = sys_cpu_to_le16(CCCTable::get(conn, instance->m_ccc_idx));
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &value, sizeof(value));
+}
+
+ssize_t ICharacteristicCCC::_ccc_write(bt_conn *conn, const bt_gatt_attr *attr,
+                                       const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+    ARG_UNUSED(flags);
+    auto instance = static_cast<const ICharacteristicCCC*>(attr->user_data);
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    if (len == 0 || len > sizeof(uint16_t)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+    const auto data = static_cast<const uint8_t *>(buf);
+    const uint16_t value = len < sizeof(uint16_t) ? data[0] : sys_get_le16(data);
+    if (value & ~(BT_GATT_CCC_NOTIFY | BT_GATT_CCC_INDICATE)) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+    if (CCCTable::set(conn, instance->m_ccc_idx, value) != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+    }
+    const_cast<ICharacteristicCCC*>(instance)->written(conn, value);
+    return len;
+}
+#else
+void ICharacteristicCCC::_ccc_changed(const bt_gatt_attr *attr, uint16_t value)
+{
+    auto ccc_data = static_cast<const gatt_ccc*>(attr->user_data);
+    static_cast<ICharacteristicCCC*>(ccc_data->ctx)->changed(value);
+}
+
+ssize_t ICharacteristicCCC::_ccc_cfg_write(bt_conn *conn, const bt_gatt_attr *attr, uint16_t value)
+{
+    /* Called by the host before the value is stored */
+    auto ccc_data = static_cast<const gatt_ccc*>(attr->user_data);
+    static_cast<ICharacteristicCCC*>(ccc_data->ctx)->written(conn, value);
+    return sizeof(value);
+}
+#endif
+
+#if defined(CONFIG_BLE_UTILS_PUBLISH)
+/*! @brief Flag of the publish state that the shared buffer holds a new value */
+static constexpr atomic_val_t PUBLISH_DIRTY{BIT(2)};
+/*! @brief Mask of the shared buffer index in the publish state */
+static constexpr atomic_val_t PUBLISH_IDX_MASK{0x3};
+/*! @brief Retry delay when no notification buffers are available */
+static constexpr uint32_t PUBLISH_RETRY_MS{1U};
+#endif
+
 CharacteristicNotify::CharacteristicNotify(const bt_uuid * uuid, uint8_t props, uint8_t perm):
-    ICharacteristicCCC(uuid, props | BT_GATT_CHRC_NOTIFY, perm){}
+    ICharacteristicCCC(uuid, props | BT_GATT_CHRC_NOTIFY, perm)
+#if defined(CONFIG_BLE_UTILS_PUBLISH)
+    ,m_pub_work{{}, this}
+#endif
+{
+#if defined(CONFIG_BLE_UTILS_PUBLISH)
+    k_work_init_delayable(&m_pub_work.work, _publish_handler);
+#endif
+}
 
 CharacteristicNotify::CharacteristicNotify(const bt_uuid * uuid):
     CharacteristicNotify(uuid, BT_GATT_CHRC_NOTIFY, 0){}
 
+#if defined(CONFIG_BLE_UTILS_TRACING) || defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+void CharacteristicNotify::_notify_sent(bt_conn *conn, void *user_data)
+{
+    const uint16_t seq = trace::seq_of(user_data);
+    for (uint16_t i = 0; i < trace::seq_cnt(user_data); i++) {
+        trace::emit_done(trace::event::NOTIFY_DONE, seq + i, conn);
+    }
+    conn::backlog::completed(conn);
+}
+#endif
+
+void CharacteristicNotify::prepare(bt_gatt_notify_params &params, const void * data, const uint16_t len)
+{
+    params = {};
+    params.uuid = Characteristic::m_attr_value.uuid;
+    params.data = data;
+    params.len = len;
+#if defined(CONFIG_BLE_UTILS_TRACING) || defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+    params.func = _notify_sent;
+    params.user_data = trace::seq_data(trace::next_seq());
+#endif
+}
+
+#if defined(CONFIG_BLE_UTILS_BROADCAST)
+void CharacteristicNotify::broadcast(const void * data, const uint16_t len)
+{
+    if (m_broadcaster != nullptr) {
+        m_broadcaster->publish(m_broadcast_slot, data, len);
+    }
+}
+#endif
+
 int CharacteristicNotify::notify(const void * data, const uint16_t len)
 {
-    const int gatt_res = bt_gatt_notify_uuid(nullptr,
-                                            Characteristic::m_attr_value.uuid,
-                                            nullptr,
-                                            data,
-                                            len);
+    bt_gatt_notify_params params;
+    prepare(params, data, len);
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+    const int gatt_res = CCCTable::notify(m_ccc_idx, params);
+#else
+    const int gatt_res = bt_gatt_notify_cb(nullptr, &params);
+#endif
+#if defined(CONFIG_BLE_UTILS_BROADCAST)
+    broadcast(data, len);
+#endif
+    if (gatt_res == 0) {
+        trace::emit_submit(trace::event::NOTIFY_SUBMIT, params.uuid,
+                           trace::seq_of(params.user_data), len);
+#if !defined(CONFIG_BLE_UTILS_CCC_COMPACT) && defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+        /* Count the connections the host sends to */
+        conn::backlog::submitted(m_value_attr, BT_GATT_CCC_NOTIFY, len);
+#endif
+    }
     return gatt_res;
 }
 
+#if defined(CONFIG_BLE_UTILS_PUBLISH)
+int CharacteristicNotify::publish(const void * data, const uint16_t len)
+{
+    if (len > PUBLISH_MAX_LEN) {
+        return -EMSGSIZE;
+    }
+    memcpy(m_pub_buf[m_pub_back], data, len);
+    m_pub_len[m_pub_back] = len;
+    /* Swap the back buffer with the shared one, wait-free */
+    const atomic_val_t prev = atomic_set(&m_pub_state, m_pub_back | PUBLISH_DIRTY);
+    m_pub_back = prev & PUBLISH_IDX_MASK;
+    k_work_schedule(&m_pub_work.work, K_NO_WAIT);
+    return 0;
+}
+
+void CharacteristicNotify::_publish_handler(k_work *work)
+{
+    k_work_delayable *dwork = k_work_delayable_from_work(work);
+    auto instance = CONTAINER_OF(dwork, PublishWork, work)->chrc;
+    if (atomic_get(&instance->m_pub_state) & PUBLISH_DIRTY) {
+        /* A newer value replaces the one that was not sent yet */
+        const atomic_val_t prev = atomic_set(&instance->m_pub_state, instance->m_pub_front);
+        instance->m_pub_front = prev & PUBLISH_IDX_MASK;
+        instance->m_pub_pending = true;
+    }
+    if (!instance->m_pub_pending) {
+        return;
+    }
+    const uint8_t front = instance->m_pub_front;
+    const int err = instance->notify(instance->m_pub_buf[front], instance->m_pub_len[front]);
+    if (err == -ENOMEM) {
+        k_work_schedule(&instance->m_pub_work.work, K_MSEC(PUBLISH_RETRY_MS));
+        return;
+    }
+    instance->m_pub_pending = false;
+}
+#endif
+
+#if defined(CONFIG_BLE_UTILS_BROADCAST)
+int CharacteristicNotify::enable_broadcast(adv::Broadcaster &broadcaster, uint16_t max_len)
+{
+    const int slot = broadcaster.add(Characteristic::m_attr_value.uuid, max_len);
+    if (slot < 0) {
+        return slot;
+    }
+    m_broadcaster = &broadcaster;
+    m_broadcast_slot = static_cast<uint8_t>(slot);
+    return 0;
+}
+#endif
+
 CharacteristicIndicate::CharacteristicIndicate(const bt_uuid * uuid):
     CharacteristicIndicate(uuid, BT_GATT_CHRC_INDICATE, 0){}
 
@@ -199,7 +629,11 @@ CharacteristicIndicate::CharacteristicIndicate(const bt_uuid * uuid, uint8_t pro
         indicate_params({
         .uuid = Characteristic::m_attr_value.uuid,
         .attr = &m_attr_value,
+#if defined(CONFIG_BLE_UTILS_TRACING) || defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+        .func = _indicate_confirm,
+#else
         .func = nullptr,
+#endif
         .destroy = _indicate_rsp,
         .data = nullptr,
         .len = 0,
@@ -208,9 +642,31 @@ CharacteristicIndicate::CharacteristicIndicate(const bt_uuid * uuid, uint8_t pro
 {
 }
 
+#if defined(CONFIG_BLE_UTILS_TRACING) || defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+void CharacteristicIndicate::_indicate_confirm(bt_conn *conn, bt_gatt_indicate_params *params, uint8_t err)
+{
+#if defined(CONFIG_BLE_UTILS_TRACING)
+    auto instance = static_cast<CharacteristicIndicate*>(params->attr->user_data);
+    if (err == 0) {
+        trace::emit_done(trace::event::INDICATE_CONFIRM, instance->m_trace_seq, conn);
+    }
+#else
+    ARG_UNUSED(params);
+    ARG_UNUSED(err);
+#endif
+    conn::backlog::completed(conn);
+}
+#endif
+
 void CharacteristicIndicate::_indicate_rsp(struct bt_gatt_indicate_params *params)
 {
     auto instance = static_cast<CharacteristicIndicate*>(params->attr->user_data);
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+    /* Called for every connection, the indication is done with the last one */
+    if (atomic_dec(&instance->m_ind_pending) != 1) {
+        return;
+    }
+#endif
     instance->indicate_rsp();
 }
 
@@ -218,7 +674,22 @@ int CharacteristicIndicate::indicate(const void * data, const uint16_t len)
 {
     indicate_params.data = data;
     indicate_params.len = len;
+#if defined(CONFIG_BLE_UTILS_TRACING)
+    m_trace_seq = trace::next_seq();
+#endif
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+    const int gatt_res = CCCTable::indicate(m_ccc_idx, indicate_params, m_conn_params, m_ind_pending);
+#else
     const int gatt_res =  bt_gatt_indicate(nullptr, &indicate_params);
+#endif
+    if (gatt_res == 0) {
+#if defined(CONFIG_BLE_UTILS_TRACING)
+        trace::emit_submit(trace::event::INDICATE_SUBMIT, indicate_params.uuid, m_trace_seq, len);
+#endif
+#if !defined(CONFIG_BLE_UTILS_CCC_COMPACT) && defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+        conn::backlog::submitted(m_value_attr, BT_GATT_CCC_INDICATE, len);
+#endif
+    }
     return gatt_res;
 }
 
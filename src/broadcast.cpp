@@ -0,0 +1,158 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file broadcast.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/broadcast.hpp>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(ble_utils_broadcast, CONFIG_BLEUTILS_LOG_LEVEL);
+
+namespace ble_utils::adv
+{
+
+Broadcaster::Broadcaster(Mode mode, uint32_t min_interval_ms):
+    m_mode(mode),
+    m_min_interval_ms(min_interval_ms)
+{
+    k_mutex_init(&m_lock);
+    k_work_init_delayable(&m_work, update_work_handler);
+}
+
+int Broadcaster::init(bt_le_ext_adv *adv, const bt_data *ad, size_t ad_len)
+{
+    if (adv == nullptr || (ad == nullptr && ad_len > 0)) {
+        return -EINVAL;
+    }
+    if (m_mode == Mode::Periodic && !IS_ENABLED(CONFIG_BT_PER_ADV)) {
+        return -ENOTSUP;
+    }
+    if (ad_len > MAX_APP_AD) {
+        return -ENOMEM;
+    }
+    k_mutex_lock(&m_lock, K_FOREVER);
+    /* The application elements end where the service data starts */
+    for (size_t i = 0; i < ad_len; i++) {
+        m_ad[MAX_APP_AD - ad_len + i] = ad[i];
+    }
+    m_app_ad_cnt = static_cast<uint8_t>(ad_len);
+    m_adv = adv;
+    k_mutex_unlock(&m_lock);
+    return 0;
+}
+
+int Broadcaster::add(const bt_uuid *uuid, uint16_t max_len)
+{
+    uint8_t ad_type;
+    uint8_t uuid_len;
+    switch (uuid->type) {
+    case BT_UUID_TYPE_16:
+        ad_type = BT_DATA_SVC_DATA16;
+        uuid_len = BT_UUID_SIZE_16;
+        break;
+    case BT_UUID_TYPE_32:
+        ad_type = BT_DATA_SVC_DATA32;
+        uuid_len = BT_UUID_SIZE_32;
+        break;
+    case BT_UUID_TYPE_128:
+        ad_type = BT_DATA_SVC_DATA128;
+        uuid_len = BT_UUID_SIZE_128;
+        break;
+    default:
+        return -EINVAL;
+    }
+    const uint8_t hdr_len = uuid_len + VERSION_SIZE;
+    /* bt_data::data_len is 8 bit */
+    if (hdr_len + max_len > MAX_AD_DATA_LEN) {
+        return -EMSGSIZE;
+    }
+    const uint32_t req_size = m_data_used + hdr_len + max_len;
+    if (m_slot_cnt >= MAX_SLOTS || req_size > DATA_SIZE) {
+        return -ENOMEM;
+    }
+    Slot &slot = m_slots[m_slot_cnt];
+    slot.buf = &m_data[m_data_used];
+    slot.hdr_len = hdr_len;
+    slot.max_len = max_len;
+    slot.version = 0;
+    m_data_used += hdr_len + max_len;
+
+    switch (uuid->type) {
+    case BT_UUID_TYPE_16:
+        sys_put_le16(BT_UUID_16(uuid)->val, slot.buf);
+        break;
+    case BT_UUID_TYPE_32:
+        sys_put_le32(BT_UUID_32(uuid)->val, slot.buf);
+        break;
+    default:
+        memcpy(slot.buf, BT_UUID_128(uuid)->val, BT_UUID_SIZE_128);
+        break;
+    }
+    sys_put_le16(slot.version, &slot.buf[uuid_len]);
+
+    m_ad[MAX_APP_AD + m_slot_cnt] = {
+        .type = ad_type,
+        .data_len = hdr_len,
+        .data = slot.buf
+    };
+    return m_slot_cnt++;
+}
+
+int Broadcaster::publish(uint8_t slot_id, const void *data, uint16_t len)
+{
+    if (slot_id >= m_slot_cnt) {
+        return -EINVAL;
+    }
+    Slot &slot = m_slots[slot_id];
+    if (len > slot.max_len) {
+        return -EMSGSIZE;
+    }
+    k_mutex_lock(&m_lock, K_FOREVER);
+    slot.version++;
+    sys_put_le16(slot.version, &slot.buf[slot.hdr_len - VERSION_SIZE]);
+    memcpy(&slot.buf[slot.hdr_len], data, len);
+    m_ad[MAX_APP_AD + slot_id].data_len = slot.hdr_len + len;
+    const int64_t elapsed = k_uptime_get() - m_last_update;
+    k_mutex_unlock(&m_lock);
+
+    const int64_t delay = elapsed >= m_min_interval_ms ? 0 : m_min_interval_ms - elapsed;
+    /* Already scheduled updates are not rescheduled, the pending update sends the latest value */
+    k_work_schedule(&m_work, K_MSEC(delay));
+    return 0;
+}
+
+void Broadcaster::update_work_handler(k_work *work)
+{
+    k_work_delayable *dwork = k_work_delayable_from_work(work);
+    auto instance = CONTAINER_OF(dwork, Broadcaster, m_work);
+    if (instance->m_adv == nullptr) {
+        return;
+    }
+    int err = -ENOTSUP;
+    k_mutex_lock(&instance->m_lock, K_FOREVER);
+    if (instance->m_mode == Mode::Extended) {
+        /* The set data is replaced, it keeps the application elements */
+        err = bt_le_ext_adv_set_data(instance->m_adv,
+                                     &instance->m_ad[MAX_APP_AD - instance->m_app_ad_cnt],
+                                     instance->m_app_ad_cnt + instance->m_slot_cnt,
+                                     nullptr,
+                                     0);
+    } else {
+#if defined(CONFIG_BT_PER_ADV)
+        err = bt_le_per_adv_set_data(instance->m_adv,
+                                     &instance->m_ad[MAX_APP_AD],
+                                     instance->m_slot_cnt);
+#endif
+    }
+    instance->m_last_update = k_uptime_get();
+    k_mutex_unlock(&instance->m_lock);
+    if (err) {
+        LOG_WRN("Broadcast data update failed (err %d)", err);
+    }
+}
+
+} // namespace ble_utils::adv
@@ -0,0 +1,159 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file bulk.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/bulk.hpp>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(ble_utils_bulk, CONFIG_BLEUTILS_LOG_LEVEL);
+
+namespace ble_utils::gatt
+{
+
+static constexpr uint16_t SDU_SIZE = CONFIG_BLE_UTILS_BULK_SDU_SIZE;
+static constexpr uint16_t RX_BUF_CNT = CONFIG_BLE_UTILS_BULK_RX_BUF_CNT;
+
+NET_BUF_POOL_FIXED_DEFINE(bulk_tx_pool, CONFIG_BLE_UTILS_BULK_TX_BUF_CNT,
+                          BT_L2CAP_SDU_BUF_SIZE(SDU_SIZE), CONFIG_BT_CONN_TX_USER_DATA_SIZE, NULL);
+NET_BUF_POOL_FIXED_DEFINE(bulk_rx_pool, CONFIG_BLE_UTILS_BULK_RX_BUF_CNT,
+                          BT_L2CAP_SDU_BUF_SIZE(SDU_SIZE), 8, NULL);
+
+static bt_l2cap_chan_ops chan_ops;
+/*! @brief Registered bulk channels, each can reassemble one SDU per connection */
+static uint8_t channel_cnt;
+
+PsmCharacteristic::PsmCharacteristic(const bt_uuid * uuid, const BulkChannel &channel):
+    Characteristic(uuid, BT_GATT_CHRC_READ, BT_GATT_PERM_READ),
+    m_channel(channel)
+{
+}
+
+ssize_t PsmCharacteristic::read_cb(void *buf, uint16_t len, uint16_t offset)
+{
+    uint8_t psm[sizeof(uint16_t)];
+    sys_put_le16(m_channel.get_psm(), psm);
+    if (offset > sizeof(psm)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    const uint16_t read_len = MIN(len, sizeof(psm) - offset);
+    memcpy(buf, &psm[offset], read_len);
+    return read_len;
+}
+
+BulkChannel::BulkChannel(uint16_t psm, bt_security_t sec_level):
+    m_server{},
+    m_chans{}
+{
+    m_server.server.psm = psm;
+    m_server.server.sec_level = sec_level;
+    m_server.server.accept = _accept;
+    m_server.self = this;
+    for (auto &chan : m_chans) {
+        chan.self = this;
+    }
+}
+
+int BulkChannel::init()
+{
+    if ((channel_cnt + 1U) * CONFIG_BT_MAX_CONN > RX_BUF_CNT) {
+        LOG_ERR("Bulk receive pool too small for %u channels", channel_cnt + 1U);
+        return -ENOMEM;
+    }
+    if (chan_ops.recv == nullptr) {
+        chan_ops.connected = _connected;
+        chan_ops.disconnected = _disconnected;
+        chan_ops.alloc_buf = _alloc_buf;
+        chan_ops.recv = _recv;
+        chan_ops.sent = _sent;
+    }
+    const int err = bt_l2cap_server_register(&m_server.server);
+    if (err == 0) {
+        channel_cnt++;
+    }
+    return err;
+}
+
+uint16_t BulkChannel::get_psm() const
+{
+    return m_server.server.psm;
+}
+
+int BulkChannel::_accept(bt_conn *conn, bt_l2cap_server *server, bt_l2cap_chan **chan)
+{
+    auto instance = CONTAINER_OF(server, Server, server)->self;
+    Chan &slot = instance->m_chans[bt_conn_index(conn)];
+    if (slot.connected) {
+        return -ENOMEM;
+    }
+    slot.le = {};
+    slot.le.chan.ops = &chan_ops;
+    slot.le.rx.mtu = SDU_SIZE;
+    *chan = &slot.le.chan;
+    return 0;
+}
+
+void BulkChannel::_connected(bt_l2cap_chan *chan)
+{
+    Chan *slot = CONTAINER_OF(chan, Chan, le.chan);
+    slot->connected = true;
+    LOG_DBG("Bulk channel connected, tx mtu %u", slot->le.tx.mtu);
+    slot->self->channel_changed(chan->conn, true);
+}
+
+void BulkChannel::_disconnected(bt_l2cap_chan *chan)
+{
+    Chan *slot = CONTAINER_OF(chan, Chan, le.chan);
+    slot->connected = false;
+    slot->self->channel_changed(chan->conn, false);
+}
+
+net_buf * BulkChannel::_alloc_buf(bt_l2cap_chan *chan)
+{
+    ARG_UNUSED(chan);
+    /* Runs in the BT RX context, must not block. init() sizes the pool for every channel */
+    return net_buf_alloc(&bulk_rx_pool, K_NO_WAIT);
+}
+
+int BulkChannel::_recv(bt_l2cap_chan *chan, net_buf *buf)
+{
+    Chan *slot = CONTAINER_OF(chan, Chan, le.chan);
+    slot->self->recv_cb(chan->conn, buf->data, buf->len);
+    /* The SDU was consumed, zephyr returns its credits */
+    return 0;
+}
+
+void BulkChannel::_sent(bt_l2cap_chan *chan)
+{
+    Chan *slot = CONTAINER_OF(chan, Chan, le.chan);
+    slot->self->sent_cb(chan->conn);
+}
+
+int BulkChannel::send(bt_conn *conn, const void *data, uint16_t len)
+{
+    Chan &slot = m_chans[bt_conn_index(conn)];
+    if (!slot.connected) {
+        return -ENOTCONN;
+    }
+    if (len > SDU_SIZE || len > slot.le.tx.mtu) {
+        return -EMSGSIZE;
+    }
+    net_buf *buf = net_buf_alloc(&bulk_tx_pool, K_NO_WAIT);
+    if (buf == nullptr) {
+        return -ENOMEM;
+    }
+    net_buf_reserve(buf, BT_L2CAP_SDU_CHAN_SEND_RESERVE);
+    net_buf_add_mem(buf, data, len);
+    const int err = bt_l2cap_chan_send(&slot.le.chan, buf);
+    if (err < 0) {
+        net_buf_unref(buf);
+        return err;
+    }
+    return 0;
+}
+
+} // namespace ble_utils::gatt
@@ -0,0 +1,357 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file ccc.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include "ccc.hpp"
+#include "backlog.hpp"
+#include "trace.hpp"
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/logging/log.h>
+#if defined(CONFIG_BT_SETTINGS)
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/printk.h>
+#include <stdlib.h>
+#endif
+
+LOG_MODULE_REGISTER(ble_utils_ccc, CONFIG_BLEUTILS_LOG_LEVEL);
+
+namespace ble_utils::gatt
+{
+
+static constexpr size_t MAX_CHRC = CONFIG_BLE_UTILS_CCC_COMPACT_MAX_CHRC;
+/*! @brief Connected and bonded peers, the same capacity as a zephyr CCC */
+static constexpr size_t MAX_PEERS = BT_GATT_CCC_MAX;
+static constexpr uint16_t CCC_MASK = BT_GATT_CCC_NOTIFY | BT_GATT_CCC_INDICATE;
+/*! @brief Bits of a CCC value in the table */
+static constexpr uint8_t CCC_BITS = 2U;
+static constexpr uint8_t CCC_PER_BYTE = 8U / CCC_BITS;
+
+/**
+ * @brief CCC values of a peer
+ */
+struct Peer
+{
+    bt_addr_le_t addr;
+    uint8_t id;
+    bool used;
+    uint8_t cfg[(MAX_CHRC + CCC_PER_BYTE - 1U) / CCC_PER_BYTE];
+};
+
+static Peer peers[MAX_PEERS];
+/*! @brief Peer of every connection index, slot + 1 or 0 if the connection has none */
+static uint8_t conn_peer[CONFIG_BT_MAX_CONN];
+static bt_conn_cb conn_callbacks;
+#if defined(CONFIG_BT_SMP)
+static bt_conn_auth_info_cb auth_callbacks;
+#endif
+
+ICharacteristicCCC *CCCTable::chrcs[CONFIG_BLE_UTILS_CCC_COMPACT_MAX_CHRC];
+uint16_t CCCTable::chrc_cnt;
+
+static uint16_t cfg_get(const Peer &peer, uint16_t idx)
+{
+    const uint8_t shift = (idx % CCC_PER_BYTE) * CCC_BITS;
+    return (peer.cfg[idx / CCC_PER_BYTE] >> shift) & CCC_MASK;
+}
+
+static void cfg_set(Peer &peer, uint16_t idx, uint16_t value)
+{
+    const uint8_t shift = (idx % CCC_PER_BYTE) * CCC_BITS;
+    uint8_t &cfg = peer.cfg[idx / CCC_PER_BYTE];
+    cfg = (cfg & ~(CCC_MASK << shift)) | (value << shift);
+}
+
+static void store(size_t slot)
+{
+#if defined(CONFIG_BT_SETTINGS)
+    char key[sizeof("bleutils/ccc/") + 3];
+    snprintk(key, sizeof(key), "bleutils/ccc/%u", static_cast<unsigned>(slot));
+    int err;
+    if (peers[slot].used) {
+        err = settings_save_one(key, &peers[slot], sizeof(Peer));
+    } else {
+        err = settings_delete(key);
+    }
+    if (err) {
+        LOG_WRN("CCC store failed (err %d)", err);
+    }
+#else
+    ARG_UNUSED(slot);
+#endif
+}
+
+#if defined(CONFIG_BT_SETTINGS)
+static int settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+    const unsigned long slot = strtoul(name, nullptr, 10);
+    if (slot >= MAX_PEERS || len != sizeof(Peer)) {
+        /* Stored by a firmware with a different table */
+        return -EINVAL;
+    }
+    const ssize_t res = read_cb(cb_arg, &peers[slot], sizeof(Peer));
+    return res < 0 ? res : 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(ble_utils_ccc, "bleutils/ccc", nullptr, settings_set, nullptr, nullptr);
+#endif
+
+static Peer * find(const bt_conn *conn)
+{
+    const uint8_t slot = conn_peer[bt_conn_index(conn)];
+    return slot != 0 ? &peers[slot - 1U] : nullptr;
+}
+
+/**
+ * @brief Find the peer of a connection by its address
+ *
+ * @param conn Connection object
+ * @param create Allocate a peer if the connection has none
+ * @return Peer or nullptr
+ */
+static Peer * lookup(bt_conn *conn, bool create)
+{
+    Peer *peer = find(conn);
+    if (peer != nullptr) {
+        return peer;
+    }
+    bt_conn_info info;
+    if (bt_conn_get_info(conn, &info) != 0) {
+        return nullptr;
+    }
+    size_t free_slot = MAX_PEERS;
+    for (size_t slot = 0; slot < MAX_PEERS; slot++) {
+        if (!peers[slot].used) {
+            free_slot = MIN(free_slot, slot);
+        } else if (peers[slot].id == info.id && bt_addr_le_eq(&peers[slot].addr, info.le.dst)) {
+            conn_peer[bt_conn_index(conn)] = slot + 1U;
+            return &peers[slot];
+        }
+    }
+    if (!create || free_slot == MAX_PEERS) {
+        return nullptr;
+    }
+    peer = &peers[free_slot];
+    *peer = {};
+    peer->used = true;
+    peer->id = info.id;
+    bt_addr_le_copy(&peer->addr, info.le.dst);
+    conn_peer[bt_conn_index(conn)] = free_slot + 1U;
+    return peer;
+}
+
+static void connected(bt_conn *conn, uint8_t err)
+{
+    if (err) {
+        return;
+    }
+    /* A bonded peer gets its values back */
+    if (lookup(conn, false) != nullptr) {
+        CCCTable::refresh();
+    }
+}
+
+static void disconnected(bt_conn *conn, uint8_t reason)
+{
+    ARG_UNUSED(reason);
+    const uint8_t idx = bt_conn_index(conn);
+    const uint8_t slot = conn_peer[idx];
+    if (slot == 0) {
+        return;
+    }
+    conn_peer[idx] = 0;
+    Peer &peer = peers[slot - 1U];
+    if (bt_addr_le_is_bonded(peer.id, &peer.addr)) {
+        store(slot - 1U);
+    } else {
+        peer = {};
+    }
+    CCCTable::refresh();
+}
+
+#if defined(CONFIG_BT_SMP)
+static void identity_resolved(bt_conn *conn, const bt_addr_le_t *rpa, const bt_addr_le_t *identity)
+{
+    ARG_UNUSED(rpa);
+    Peer *peer = find(conn);
+    if (peer != nullptr) {
+        bt_addr_le_copy(&peer->addr, identity);
+    }
+}
+
+static void bond_deleted(uint8_t id, const bt_addr_le_t *addr)
+{
+    for (size_t slot = 0; slot < MAX_PEERS; slot++) {
+        Peer &peer = peers[slot];
+        if (!peer.used || peer.id != id || !bt_addr_le_eq(&peer.addr, addr)) {
+            continue;
+        }
+        bool connected = false;
+        for (const uint8_t conn_slot : conn_peer) {
+            connected = connected || conn_slot == slot + 1U;
+        }
+        if (!connected) {
+            /* A connected peer is released when it disconnects */
+            peer = {};
+            store(slot);
+        }
+    }
+}
+#endif
+
+uint16_t CCCTable::add(ICharacteristicCCC *chrc)
+{
+    __ASSERT(chrc_cnt < MAX_CHRC, "Increase CONFIG_BLE_UTILS_CCC_COMPACT_MAX_CHRC");
+    if (conn_callbacks.connected == nullptr) {
+        conn_callbacks.connected = connected;
+        conn_callbacks.disconnected = disconnected;
+#if defined(CONFIG_BT_SMP)
+        conn_callbacks.identity_resolved = identity_resolved;
+        auth_callbacks.bond_deleted = bond_deleted;
+        bt_conn_auth_info_cb_register(&auth_callbacks);
+#endif
+        bt_conn_cb_register(&conn_callbacks);
+    }
+    chrcs[chrc_cnt] = chrc;
+    return chrc_cnt++;
+}
+
+uint16_t CCCTable::get(bt_conn *conn, uint16_t idx)
+{
+    const Peer *peer = lookup(conn, false);
+    return peer != nullptr ? cfg_get(*peer, idx) : 0;
+}
+
+int CCCTable::set(bt_conn *conn, uint16_t idx, uint16_t value)
+{
+    Peer *peer = lookup(conn, value != 0);
+    if (peer == nullptr) {
+        return value != 0 ? -ENOMEM : 0;
+    }
+    cfg_set(*peer, idx, value & CCC_MASK);
+    if (bt_addr_le_is_bonded(peer->id, &peer->addr)) {
+        store(peer - peers);
+    }
+    update(idx);
+    return 0;
+}
+
+bool CCCTable::match(const bt_conn *conn, uint16_t idx, uint16_t type)
+{
+    const Peer *peer = find(conn);
+    return peer != nullptr && (cfg_get(*peer, idx) & type) != 0;
+}
+
+void CCCTable::update(uint16_t idx)
+{
+    /* Like zephyr, the value is the highest of the connected peers */
+    uint16_t value = 0;
+    for (const uint8_t slot : conn_peer) {
+        if (slot != 0) {
+            value = MAX(value, cfg_get(peers[slot - 1U], idx));
+        }
+    }
+    ICharacteristicCCC *chrc = chrcs[idx];
+    if (value != chrc->m_ccc_value) {
+        chrc->m_ccc_value = value;
+        chrc->changed(value);
+    }
+}
+
+void CCCTable::refresh()
+{
+    for (uint16_t idx = 0; idx < chrc_cnt; idx++) {
+        update(idx);
+    }
+}
+
+/**
+ * @brief Context of a send to all subscribed connections
+ */
+struct SendCtx
+{
+    uint16_t idx;
+    void *params;
+    int err;
+};
+
+static void send_result(int &result, int err)
+{
+    /* Keep the first error, -ENOTCONN only if nothing was sent */
+    if (result == -ENOTCONN || result == 0) {
+        result = err;
+    }
+}
+
+static void notify_conn(bt_conn *conn, void *data)
+{
+    auto ctx = static_cast<SendCtx *>(data);
+    if (CCCTable::match(conn, ctx->idx, BT_GATT_CCC_NOTIFY)) {
+        auto params = static_cast<bt_gatt_notify_params *>(ctx->params);
+        const int err = bt_gatt_notify_cb(conn, params);
+        if (err == 0) {
+            conn::backlog::submitted(conn, params->len);
+        }
+        send_result(ctx->err, err);
+    }
+}
+
+/**
+ * @brief Context of an indication to all subscribed connections
+ */
+struct IndicateCtx
+{
+    uint16_t idx;
+    const bt_gatt_indicate_params *params;
+    bt_gatt_indicate_params *conn_params;
+    atomic_t *pending;
+    /*! Parameters of the last indication that was sent */
+    bt_gatt_indicate_params *sent;
+    int err;
+};
+
+static void indicate_conn(bt_conn *conn, void *data)
+{
+    auto ctx = static_cast<IndicateCtx *>(data);
+    if (CCCTable::match(conn, ctx->idx, BT_GATT_CCC_INDICATE)) {
+        bt_gatt_indicate_params *params = &ctx->conn_params[bt_conn_index(conn)];
+        *params = *ctx->params;
+        /* Counted before the send, the confirmation can arrive before it returns */
+        atomic_inc(ctx->pending);
+        const int err = bt_gatt_indicate(conn, params);
+        if (err == 0) {
+            ctx->sent = params;
+            conn::backlog::submitted(conn, params->len);
+        } else {
+            atomic_dec(ctx->pending);
+        }
+        send_result(ctx->err, err);
+    }
+}
+
+int CCCTable::notify(uint16_t idx, bt_gatt_notify_params &params)
+{
+    SendCtx ctx{idx, &params, -ENOTCONN};
+    bt_conn_foreach(BT_CONN_TYPE_LE, notify_conn, &ctx);
+    return ctx.err;
+}
+
+int CCCTable::indicate(uint16_t idx, const bt_gatt_indicate_params &params,
+                       bt_gatt_indicate_params *conn_params, atomic_t &pending)
+{
+    /* The sender holds a reference, a connection can confirm before the others got theirs */
+    atomic_set(&pending, 1);
+    IndicateCtx ctx{idx, &params, conn_params, &pending, nullptr, -ENOTCONN};
+    bt_conn_foreach(BT_CONN_TYPE_LE, indicate_conn, &ctx);
+    if (ctx.sent != nullptr) {
+        /* Released like a confirmation, the last one calls destroy once */
+        ctx.sent->destroy(ctx.sent);
+    } else {
+        atomic_clear(&pending);
+    }
+    return ctx.err;
+}
+
+} // namespace ble_utils::gatt
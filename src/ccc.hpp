@@ -0,0 +1,109 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file ccc.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Internal compact CCC storage. The CCC values of all characteristics are
+* kept in one table of peers with two bits per characteristic, instead of a
+* zephyr configuration array (BT_GATT_CCC_MAX entries) per characteristic.
+********************************************************************/
+
+#pragma once
+
+#include <ble_utils/ble_utils.hpp>
+
+namespace ble_utils::gatt
+{
+
+/**
+ * @brief Shared CCC table
+ * @details The descriptors are served by the library instead of the zephyr host, so
+ *          notifications and indications are sent per subscribed connection. Values of
+ *          peers that are bonded when they disconnect are kept, all others are released.
+ */
+class CCCTable
+{
+public:
+    /**
+     * @brief Add a characteristic to the table
+     *
+     * @param chrc Characteristic with CCC
+     * @return Index of the characteristic in the table
+     */
+    static uint16_t add(ICharacteristicCCC *chrc);
+
+    /**
+     * @brief Get the CCC value of a connection
+     *
+     * @param conn Connection object
+     * @param idx Index of the characteristic
+     * @return CCC value
+     */
+    static uint16_t get(bt_conn *conn, uint16_t idx);
+
+    /**
+     * @brief Set the CCC value of a connection
+     *
+     * @param conn Connection object
+     * @param idx Index of the characteristic
+     * @param value CCC value
+     * @return 0 on success or -ENOMEM if the table has no room for the peer
+     */
+    static int set(bt_conn *conn, uint16_t idx, uint16_t value);
+
+    /**
+     * @brief Check if a connection is subscribed
+     *
+     * @param conn Connection object
+     * @param idx Index of the characteristic
+     * @param type BT_GATT_CCC_NOTIFY or BT_GATT_CCC_INDICATE
+     * @return true if the connection is subscribed
+     */
+    static bool match(const bt_conn *conn, uint16_t idx, uint16_t type);
+
+    /**
+     * @brief Notify all subscribed connections
+     *
+     * @param idx Index of the characteristic
+     * @param params Notification parameters
+     * @return 0 on success, -ENOTCONN if no connection is subscribed or the zephyr error
+     */
+    static int notify(uint16_t idx, bt_gatt_notify_params &params);
+
+    /**
+     * @brief Indicate all subscribed connections
+     * @details The host keeps the parameters until the connection confirms the indication,
+     *          so every connection gets its own copy of @p params. The destroy callback of
+     *          @p params is called for every confirmation and once by the sender. It must
+     *          decrement @p pending, the indication is done when it drops to zero.
+     *
+     * @param idx Index of the characteristic
+     * @param params Indication parameters
+     * @param conn_params Parameters of every connection, indexed by bt_conn_index()
+     * @param pending References to the indication that are not released yet
+     * @return 0 on success, -ENOTCONN if no connection is subscribed or the zephyr error
+     */
+    static int indicate(uint16_t idx, const bt_gatt_indicate_params &params,
+                        bt_gatt_indicate_params *conn_params, atomic_t &pending);
+
+    /**
+     * @brief Update the CCC values of all characteristics over the connected peers
+     * @details Calls @ref ICharacteristicCCC::ccc_changed for every value that changed.
+     */
+    static void refresh();
+
+private:
+    /**
+     * @brief Update the CCC value of a characteristic over the connected peers
+     *
+     * @param idx Index of the characteristic
+     */
+    static void update(uint16_t idx);
+
+    static ICharacteristicCCC *chrcs[CONFIG_BLE_UTILS_CCC_COMPACT_MAX_CHRC];
+    static uint16_t chrc_cnt;
+};
+
+} // namespace ble_utils::gatt
@@ -0,0 +1,292 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file conn_manager.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/conn_manager.hpp>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(ble_utils_conn_manager, CONFIG_BLEUTILS_LOG_LEVEL);
+
+namespace ble_utils::client
+{
+
+/*! @brief Active manager, the zephyr connection callbacks have no context */
+static ConnManager *manager;
+static bt_conn_cb conn_callbacks;
+
+ConnManager::ConnManager(const scan::FilterTable &filter,
+                         const bt_uuid *svc_uuid,
+                         const bt_le_scan_param &scan_param,
+                         const bt_conn_le_create_param &create_param,
+                         const bt_le_conn_param &conn_param):
+    scan::Scanner(filter),
+    m_svc_uuid(svc_uuid),
+    m_scan_param(scan_param),
+    m_create_param(create_param),
+    m_conn_param(conn_param),
+    m_links{},
+    m_stats{}
+{
+    for (auto &link : m_links) {
+        link.self = this;
+    }
+}
+
+int ConnManager::start()
+{
+    __ASSERT(manager == nullptr || manager == this, "Only one connection manager can be active");
+    manager = this;
+    if (conn_callbacks.connected == nullptr) {
+        conn_callbacks.connected = _connected;
+        conn_callbacks.disconnected = _disconnected;
+        bt_conn_cb_register(&conn_callbacks);
+    }
+    const int err = scan::Scanner::start(m_scan_param);
+    m_scanning = err == 0;
+    return err;
+}
+
+ConnManager::Link * ConnManager::find(const bt_conn *conn)
+{
+    for (auto &link : m_links) {
+        if (link.state != State::Idle && link.conn == conn) {
+            return &link;
+        }
+    }
+    return nullptr;
+}
+
+ConnManager::Link * ConnManager::find_free()
+{
+    for (auto &link : m_links) {
+        if (link.state == State::Idle) {
+            return &link;
+        }
+    }
+    return nullptr;
+}
+
+void ConnManager::enter(Link &link, State state)
+{
+    const int64_t now = k_uptime_get();
+    if (link.state != State::Idle && link.state != State::Ready) {
+        StageStats &stats = m_stats[static_cast<size_t>(link.state)];
+        const uint32_t duration = static_cast<uint32_t>(now - link.stage_start);
+        stats.samples++;
+        stats.total_ms += duration;
+        stats.max_ms = MAX(stats.max_ms, duration);
+    }
+    link.state = state;
+    link.stage_start = now;
+}
+
+void ConnManager::release(Link &link)
+{
+    if (link.conn != nullptr) {
+        bt_conn_unref(link.conn);
+        link.conn = nullptr;
+    }
+    /* An aborted stage is not part of the statistics */
+    link.state = State::Idle;
+}
+
+void ConnManager::fail(Link &link)
+{
+    const int err = bt_conn_disconnect(link.conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+    if (err) {
+        LOG_WRN("Disconnect failed (err %d)", err);
+    }
+}
+
+void ConnManager::resume_scan()
+{
+    const bool initiator_free = !m_initiating ||
+                                IS_ENABLED(CONFIG_BT_SCAN_AND_INITIATE_IN_PARALLEL);
+    if (m_scanning || !initiator_free || find_free() == nullptr) {
+        return;
+    }
+    const int err = scan::Scanner::start(m_scan_param);
+    if (err) {
+        LOG_WRN("Scan restart failed (err %d)", err);
+        return;
+    }
+    m_scanning = true;
+}
+
+void ConnManager::device_found(const bt_le_scan_recv_info *info, net_buf_simple *ad)
+{
+    ARG_UNUSED(ad);
+    Link *link = find_free();
+    if (link == nullptr || m_initiating) {
+        return;
+    }
+    bt_conn *existing = bt_conn_lookup_addr_le(BT_ID_DEFAULT, info->addr);
+    if (existing != nullptr) {
+        bt_conn_unref(existing);
+        return;
+    }
+    if (!IS_ENABLED(CONFIG_BT_SCAN_AND_INITIATE_IN_PARALLEL)) {
+        const int err = scan::Scanner::stop();
+        if (err) {
+            LOG_WRN("Scan stop failed (err %d)", err);
+            return;
+        }
+        m_scanning = false;
+    }
+    enter(*link, State::Connecting);
+    const int err = bt_conn_le_create(info->addr, &m_create_param, &m_conn_param, &link->conn);
+    if (err) {
+        LOG_WRN("Create conn failed (err %d)", err);
+        link->conn = nullptr;
+        release(*link);
+        resume_scan();
+        return;
+    }
+    m_initiating = true;
+    if (find_free() == nullptr && m_scanning) {
+        scan::Scanner::stop();
+        m_scanning = false;
+    }
+}
+
+void ConnManager::_connected(bt_conn *conn, uint8_t err)
+{
+    if (manager == nullptr) {
+        return;
+    }
+    Link *link = manager->find(conn);
+    if (link != nullptr && link->state == State::Connecting) {
+        manager->connected(*link, err);
+    }
+}
+
+void ConnManager::connected(Link &link, uint8_t err)
+{
+    m_initiating = false;
+    if (err) {
+        LOG_DBG("Connection failed (err 0x%02x)", err);
+        release(link);
+        resume_scan();
+        return;
+    }
+    enter(link, State::Discovering);
+    link.params = {};
+    link.params.uuid = m_svc_uuid;
+    link.params.func = _discover_cb;
+    link.params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+    link.params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+    link.params.type = BT_GATT_DISCOVER_PRIMARY;
+    const int res = bt_gatt_discover(link.conn, &link.params);
+    if (res) {
+        LOG_WRN("Service discover failed (err %d)", res);
+        fail(link);
+    }
+    resume_scan();
+}
+
+void ConnManager::_disconnected(bt_conn *conn, uint8_t reason)
+{
+    if (manager == nullptr) {
+        return;
+    }
+    Link *link = manager->find(conn);
+    if (link == nullptr) {
+        return;
+    }
+    manager->disconnected(conn, reason);
+    manager->release(*link);
+    manager->resume_scan();
+}
+
+uint8_t ConnManager::_discover_cb(bt_conn *conn, const bt_gatt_attr *attr,
+                                  bt_gatt_discover_params *params)
+{
+    ARG_UNUSED(conn);
+    Link *link = CONTAINER_OF(params, Link, params);
+    return link->self->discover_cb(*link, attr);
+}
+
+uint8_t ConnManager::discover_cb(Link &link, const bt_gatt_attr *attr)
+{
+    if (link.state != State::Discovering) {
+        /* Completion of a discovery that was cancelled after the link was released */
+        return BT_GATT_ITER_STOP;
+    }
+    if (link.params.type == BT_GATT_DISCOVER_PRIMARY) {
+        if (attr == nullptr) {
+            LOG_WRN("Service not found");
+            fail(link);
+            return BT_GATT_ITER_STOP;
+        }
+        const auto svc = static_cast<const bt_gatt_service_val *>(attr->user_data);
+        link.params.uuid = nullptr;
+        link.params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+        link.params.start_handle = attr->handle + 1U;
+        link.params.end_handle = svc->end_handle;
+        const int err = bt_gatt_discover(link.conn, &link.params);
+        if (err) {
+            LOG_WRN("Characteristic discover failed (err %d)", err);
+            fail(link);
+        }
+        return BT_GATT_ITER_STOP;
+    }
+    if (attr == nullptr) {
+        /* The discovery also ends when the connection is lost or is being cancelled */
+        bt_conn_info info;
+        if (bt_conn_get_info(link.conn, &info) != 0 || info.state != BT_CONN_STATE_CONNECTED) {
+            fail(link);
+            return BT_GATT_ITER_STOP;
+        }
+        subscribing(link);
+        return BT_GATT_ITER_STOP;
+    }
+    characteristic_found(link.conn, attr, static_cast<const bt_gatt_chrc *>(attr->user_data));
+    return BT_GATT_ITER_CONTINUE;
+}
+
+void ConnManager::subscribing(Link &link)
+{
+    enter(link, State::Subscribing);
+    const int err = subscribe(link.conn);
+    if (err != -EINPROGRESS) {
+        subscribe_done(link.conn, err);
+    }
+}
+
+void ConnManager::subscribe_done(bt_conn *conn, int err)
+{
+    Link *link = find(conn);
+    if (link == nullptr || link->state != State::Subscribing) {
+        return;
+    }
+    if (err) {
+        LOG_WRN("Subscribe failed (err %d)", err);
+        fail(*link);
+        return;
+    }
+    enter(*link, State::Ready);
+    ready(conn);
+}
+
+uint8_t ConnManager::count(State state) const
+{
+    uint8_t cnt = 0;
+    for (const auto &link : m_links) {
+        if (link.state == state) {
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+const ConnManager::StageStats & ConnManager::stage(State state) const
+{
+    return m_stats[static_cast<size_t>(state)];
+}
+
+} // namespace ble_utils::client
@@ -0,0 +1,568 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file conn_tuning.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/conn_tuning.hpp>
+#include "backlog.hpp"
+#include "trace.hpp"
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(ble_utils_conn, CONFIG_BLEUTILS_LOG_LEVEL);
+
+namespace ble_utils::conn
+{
+
+static constexpr uint8_t MAX_LISTENERS = CONFIG_BLE_UTILS_CONN_TUNING_MAX_LISTENERS;
+
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+namespace adaptive
+{
+static constexpr uint32_t SAMPLE_MS = CONFIG_BLE_UTILS_CONN_ADAPTIVE_SAMPLE_MS;
+/*! @brief Samples of the one second window of the send rate */
+static constexpr uint8_t RATE_SLOTS = MAX(MSEC_PER_SEC / SAMPLE_MS, 1U);
+
+/**
+ * @brief Sends of a sample period
+ */
+struct RateSlot
+{
+    uint16_t sends;
+    uint16_t elapsed_ms;
+    uint32_t bytes;
+};
+} // namespace adaptive
+#endif
+
+/**
+ * @brief Internal state of a tracked connection
+ */
+struct Link
+{
+    bt_conn *conn;
+    LinkParams params;
+    /*! Work item that issues the profile requests outside of the BT RX context */
+    k_work work;
+#if defined(CONFIG_BT_GATT_CLIENT)
+    bt_gatt_exchange_params mtu_params;
+#endif
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+    /*! Mode whose parameters were requested for this connection */
+    adaptive::Mode mode;
+    /*! Mode decided by the last sample of this connection */
+    adaptive::Mode target;
+    /*! Sends to this connection that did not complete */
+    atomic_t pending;
+    /*! Sends and bytes since the last sample */
+    atomic_t sends;
+    atomic_t bytes;
+    adaptive::RateSlot rate_slots[adaptive::RATE_SLOTS];
+    uint8_t rate_idx;
+    int64_t last_sample_ms;
+    int64_t last_busy_ms;
+    int64_t target_since_ms;
+#endif
+};
+
+static bool initialized;
+static Profile active_profile;
+static Link links[CONFIG_BT_MAX_CONN];
+static ILinkListener * listeners[MAX_LISTENERS];
+static uint8_t listener_cnt;
+static bt_conn_cb conn_callbacks;
+static bt_gatt_cb gatt_callbacks;
+
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+namespace adaptive
+{
+static Policy active_policy;
+static bool running;
+static Stats stats;
+static k_spinlock stats_lock;
+static k_work_delayable work;
+static k_work_sync work_sync;
+} // namespace adaptive
+#endif
+
+static Link * get_link(const bt_conn *conn)
+{
+    Link * link = &links[bt_conn_index(conn)];
+    return link->conn == conn ? link : nullptr;
+}
+
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+namespace backlog
+{
+
+static void count(Link &link, uint16_t len)
+{
+    const atomic_val_t prev = atomic_inc(&link.pending);
+    atomic_inc(&link.sends);
+    atomic_add(&link.bytes, len);
+    /* Switch as soon as the backlog builds up instead of waiting for the next sample */
+    if (adaptive::running && link.target != adaptive::Mode::Active &&
+        prev + 1 >= adaptive::active_policy.active_backlog) {
+        k_work_reschedule(&adaptive::work, K_NO_WAIT);
+    }
+}
+
+void submitted(bt_conn *conn, uint16_t len)
+{
+    Link *link = get_link(conn);
+    if (link != nullptr) {
+        count(*link, len);
+    }
+}
+
+void submitted(const bt_gatt_attr *attr, uint16_t type, uint16_t len)
+{
+    if (attr == nullptr) {
+        return;
+    }
+    /* The host sends to every subscribed connection */
+    for (auto &link : links) {
+        if (link.conn != nullptr && bt_gatt_is_subscribed(link.conn, attr, type)) {
+            count(link, len);
+        }
+    }
+}
+
+void completed(bt_conn *conn)
+{
+    Link *link = get_link(conn);
+    if (link == nullptr) {
+        return;
+    }
+    atomic_val_t prev = atomic_get(&link->pending);
+    while (prev > 0 && !atomic_cas(&link->pending, prev, prev - 1)) {
+        prev = atomic_get(&link->pending);
+    }
+}
+
+} // namespace backlog
+#endif
+
+static void notify_listeners(const Link *link)
+{
+    for (uint8_t i = 0; i < listener_cnt; i++) {
+        listeners[i]->link_updated(link->conn, link->params);
+    }
+}
+
+#if defined(CONFIG_BT_GATT_CLIENT)
+static void mtu_exchanged(bt_conn *conn, uint8_t err, bt_gatt_exchange_params *params)
+{
+    ARG_UNUSED(conn);
+    ARG_UNUSED(params);
+    if (err) {
+        LOG_WRN("MTU exchange failed (err %u)", err);
+    }
+}
+#endif
+
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+namespace adaptive
+{
+
+static const char * mode_str(Mode value)
+{
+    switch (value) {
+    case Mode::Active:
+        return "active";
+    case Mode::Idle:
+        return "idle";
+    default:
+        return "none";
+    }
+}
+
+/**
+ * @brief Request the parameters of a mode for a connection
+ * @details A failed request is retried at the next sample.
+ *
+ * @param link Connection to update
+ * @param target Mode whose parameters are requested
+ * @param sample Sample of the connection that decided the mode
+ */
+static void request(Link &link, Mode target, const Sample &sample)
+{
+    const bt_le_conn_param &param = target == Mode::Active ? active_policy.active : active_policy.idle;
+    const int err = bt_conn_le_param_update(link.conn, &param);
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+    if (err && err != -EALREADY) {
+        stats.req_failed++;
+        k_spin_unlock(&stats_lock, key);
+        LOG_DBG("Adaptive conn. param request failed (err %d)", err);
+        return;
+    }
+    k_spin_unlock(&stats_lock, key);
+    link.mode = target;
+    const uint8_t idx = bt_conn_index(link.conn);
+    LOG_INF("Conn %u %s: interval %u-%u latency %u timeout %u (backlog %u, %u/s, %u B/s)",
+            idx, mode_str(target), param.interval_min, param.interval_max,
+            param.latency, param.timeout, sample.backlog, sample.send_rate, sample.byte_rate);
+    trace::emit_raw(trace::event::CONN_PARAM,
+                    static_cast<uint32_t>(idx) << 16 | param.interval_max,
+                    static_cast<uint32_t>(param.latency) << 16 | sample.backlog);
+    for (uint8_t i = 0; i < listener_cnt; i++) {
+        listeners[i]->params_requested(link.conn, param, sample);
+    }
+}
+
+/**
+ * @brief Reset the sampling state of a connection
+ *
+ * @param link Connection to reset
+ * @param now Uptime of the reset
+ */
+static void reset(Link &link, int64_t now)
+{
+    link.mode = Mode::None;
+    link.target = Mode::None;
+    atomic_clear(&link.sends);
+    atomic_clear(&link.bytes);
+    for (auto &slot : link.rate_slots) {
+        slot = {};
+    }
+    link.rate_idx = 0;
+    link.last_sample_ms = now;
+    link.last_busy_ms = now;
+    link.target_since_ms = now;
+}
+
+/**
+ * @brief Sample the backlog and the send rate of a connection and request its mode
+ *
+ * @param link Connection to sample
+ * @param now Uptime of the sample
+ */
+static void sample_link(Link &link, int64_t now)
+{
+    const uint32_t elapsed = MAX(static_cast<uint32_t>(now - link.last_sample_ms), 1U);
+    link.last_sample_ms = now;
+    Sample sample;
+    sample.timestamp_ms = static_cast<uint32_t>(now);
+    const uint32_t pending = atomic_get(&link.pending);
+    sample.backlog = MIN(pending, UINT16_MAX);
+    const uint32_t period_sends = atomic_clear(&link.sends);
+    const uint32_t period_bytes = atomic_clear(&link.bytes);
+    /* A single sample period turns sporadic sends into a high rate, average over a second */
+    link.rate_slots[link.rate_idx] = {
+        .sends = static_cast<uint16_t>(MIN(period_sends, UINT16_MAX)),
+        .elapsed_ms = static_cast<uint16_t>(MIN(elapsed, UINT16_MAX)),
+        .bytes = period_bytes
+    };
+    link.rate_idx = (link.rate_idx + 1) % RATE_SLOTS;
+    uint32_t sends = 0;
+    uint32_t bytes = 0;
+    uint32_t window_ms = 0;
+    for (const auto &slot : link.rate_slots) {
+        sends += slot.sends;
+        bytes += slot.bytes;
+        window_ms += slot.elapsed_ms;
+    }
+    window_ms = MAX(window_ms, SAMPLE_MS);
+    sample.send_rate = MIN(sends * MSEC_PER_SEC / window_ms, UINT16_MAX);
+    sample.byte_rate = bytes * MSEC_PER_SEC / window_ms;
+
+    const bool busy = sample.backlog >= active_policy.active_backlog ||
+                      sample.send_rate >= active_policy.active_rate;
+    const bool idle = sample.backlog == 0 && sample.send_rate < active_policy.idle_rate;
+    if (!idle) {
+        link.last_busy_ms = now;
+    }
+    Mode next = link.target;
+    if (busy) {
+        next = Mode::Active;
+    } else if (idle && now - link.last_busy_ms >= active_policy.idle_hold_ms) {
+        next = Mode::Idle;
+    }
+    sample.mode = next;
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+    if (next != link.target) {
+        if (link.target == Mode::Active) {
+            stats.active_ms += now - link.target_since_ms;
+        }
+        if (next == Mode::Active) {
+            stats.to_active++;
+        } else {
+            stats.to_idle++;
+        }
+        link.target_since_ms = now;
+    }
+    stats.last = sample;
+    link.target = next;
+    k_spin_unlock(&stats_lock, key);
+    if (next != Mode::None && link.mode != next) {
+        request(link, next, sample);
+    }
+}
+
+static void work_handler(k_work *work)
+{
+    ARG_UNUSED(work);
+    if (!running) {
+        return;
+    }
+    const int64_t now = k_uptime_get();
+    bool sampled = false;
+    for (auto &link : links) {
+        if (link.conn != nullptr) {
+            sample_link(link, now);
+            sampled = true;
+        }
+    }
+    /* Without connections the sampling resumes with the next one */
+    if (sampled) {
+        k_work_schedule(&adaptive::work, K_MSEC(SAMPLE_MS));
+    }
+}
+
+} // namespace adaptive
+#endif
+
+static void tune_work_handler(k_work *work)
+{
+    Link *link = CONTAINER_OF(work, Link, work);
+    bt_conn *link_conn = link->conn;
+    if (link_conn == nullptr) {
+        return;
+    }
+    /* The link drops its reference on disconnect while the requests block */
+    bt_conn *conn = bt_conn_ref(link_conn);
+    if (conn == nullptr) {
+        return;
+    }
+    int err;
+#if defined(CONFIG_BT_GATT_CLIENT)
+    if (active_profile.exchange_mtu) {
+        link->mtu_params.func = mtu_exchanged;
+        err = bt_gatt_exchange_mtu(conn, &link->mtu_params);
+        if (err && err != -EALREADY) {
+            LOG_WRN("MTU exchange request failed (err %d)", err);
+        }
+    }
+#endif
+    err = bt_conn_le_data_len_update(conn, &active_profile.data_len);
+    if (err) {
+        LOG_WRN("Data length update request failed (err %d)", err);
+    }
+    err = bt_conn_le_phy_update(conn, &active_profile.phy);
+    if (err) {
+        LOG_WRN("PHY update request failed (err %d)", err);
+    }
+    err = bt_conn_le_param_update(conn, &active_profile.conn_param);
+    if (err) {
+        LOG_WRN("Conn. param update request failed (err %d)", err);
+    }
+    bt_conn_unref(conn);
+}
+
+static void connected(bt_conn *conn, uint8_t conn_err)
+{
+    if (conn_err) {
+        return;
+    }
+    bt_conn_info info;
+    if (bt_conn_get_info(conn, &info) != 0 || info.type != BT_CONN_TYPE_LE) {
+        return;
+    }
+    Link &link = links[bt_conn_index(conn)];
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+    adaptive::reset(link, k_uptime_get());
+    atomic_clear(&link.pending);
+#endif
+    link.conn = bt_conn_ref(conn);
+    link.params = {
+        .att_mtu = bt_gatt_get_mtu(conn),
+        .tx_max_len = info.le.data_len->tx_max_len,
+        .rx_max_len = info.le.data_len->rx_max_len,
+        .tx_phy = info.le.phy->tx_phy,
+        .rx_phy = info.le.phy->rx_phy,
+        .interval = info.le.interval,
+        .latency = info.le.latency,
+        .timeout = info.le.timeout
+    };
+    notify_listeners(&link);
+    k_work_submit(&link.work);
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+    if (adaptive::running) {
+        /* Sampling stops without connections, an already scheduled sample is kept */
+        k_work_schedule(&adaptive::work, K_MSEC(adaptive::SAMPLE_MS));
+    }
+#endif
+}
+
+static void disconnected(bt_conn *conn, uint8_t reason)
+{
+    ARG_UNUSED(reason);
+    Link *link = get_link(conn);
+    if (link == nullptr) {
+        return;
+    }
+    k_work_cancel(&link->work);
+    bt_conn_unref(link->conn);
+    link->conn = nullptr;
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+    /* Sends that were queued for this connection never complete */
+    atomic_clear(&link->pending);
+    k_spinlock_key_t key = k_spin_lock(&adaptive::stats_lock);
+    if (link->target == adaptive::Mode::Active) {
+        adaptive::stats.active_ms += k_uptime_get() - link->target_since_ms;
+    }
+    link->target = adaptive::Mode::None;
+    k_spin_unlock(&adaptive::stats_lock, key);
+#endif
+}
+
+static void le_param_updated(bt_conn *conn, uint16_t interval,
+                             uint16_t latency, uint16_t timeout)
+{
+    Link *link = get_link(conn);
+    if (link == nullptr) {
+        return;
+    }
+    link->params.interval = interval;
+    link->params.latency = latency;
+    link->params.timeout = timeout;
+    notify_listeners(link);
+}
+
+static void le_phy_updated(bt_conn *conn, bt_conn_le_phy_info *param)
+{
+    Link *link = get_link(conn);
+    if (link == nullptr) {
+        return;
+    }
+    link->params.tx_phy = param->tx_phy;
+    link->params.rx_phy = param->rx_phy;
+    notify_listeners(link);
+}
+
+static void le_data_len_updated(bt_conn *conn, bt_conn_le_data_len_info *info)
+{
+    Link *link = get_link(conn);
+    if (link == nullptr) {
+        return;
+    }
+    link->params.tx_max_len = info->tx_max_len;
+    link->params.rx_max_len = info->rx_max_len;
+    notify_listeners(link);
+}
+
+static void att_mtu_updated(bt_conn *conn, uint16_t tx, uint16_t rx)
+{
+    Link *link = get_link(conn);
+    if (link == nullptr) {
+        return;
+    }
+    link->params.att_mtu = MIN(tx, rx);
+    notify_listeners(link);
+}
+
+int init(const Profile &profile)
+{
+    if (initialized) {
+        return -EALREADY;
+    }
+    active_profile = profile;
+    for (auto &link : links) {
+        link.conn = nullptr;
+        k_work_init(&link.work, tune_work_handler);
+    }
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+    k_work_init_delayable(&adaptive::work, adaptive::work_handler);
+#endif
+    conn_callbacks.connected = connected;
+    conn_callbacks.disconnected = disconnected;
+    conn_callbacks.le_param_updated = le_param_updated;
+    conn_callbacks.le_phy_updated = le_phy_updated;
+    conn_callbacks.le_data_len_updated = le_data_len_updated;
+    bt_conn_cb_register(&conn_callbacks);
+    gatt_callbacks.att_mtu_updated = att_mtu_updated;
+    bt_gatt_cb_register(&gatt_callbacks);
+    initialized = true;
+    return 0;
+}
+
+void register_listener(ILinkListener *listener)
+{
+    __ASSERT(listener_cnt < MAX_LISTENERS, "Max. link listeners reached");
+    if (listener_cnt < MAX_LISTENERS) {
+        listeners[listener_cnt++] = listener;
+    }
+}
+
+int get_params(const bt_conn *conn, LinkParams &params)
+{
+    const Link *link = get_link(conn);
+    if (link == nullptr) {
+        return -ENOTCONN;
+    }
+    params = link->params;
+    return 0;
+}
+
+
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+namespace adaptive
+{
+
+int start(const Policy &policy)
+{
+    if (!initialized) {
+        return -EPERM;
+    }
+    if (running) {
+        return -EALREADY;
+    }
+    active_policy = policy;
+    const int64_t now = k_uptime_get();
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+    stats = {};
+    k_spin_unlock(&stats_lock, key);
+    for (auto &link : links) {
+        reset(link, now);
+    }
+    running = true;
+    k_work_schedule(&work, K_MSEC(SAMPLE_MS));
+    return 0;
+}
+
+void stop()
+{
+    running = false;
+    k_work_cancel_delayable_sync(&work, &work_sync);
+    const int64_t now = k_uptime_get();
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+    for (auto &link : links) {
+        if (link.target == Mode::Active) {
+            stats.active_ms += now - link.target_since_ms;
+        }
+        link.target = Mode::None;
+    }
+    k_spin_unlock(&stats_lock, key);
+}
+
+void get_stats(Stats &out)
+{
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+    out = stats;
+    const int64_t now = k_uptime_get();
+    for (const auto &link : links) {
+        if (link.target == Mode::Active) {
+            out.active_ms += now - link.target_since_ms;
+        }
+    }
+    k_spin_unlock(&stats_lock, key);
+}
+
+} // namespace adaptive
+#endif
+
+} // namespace ble_utils::conn
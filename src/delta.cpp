@@ -0,0 +1,144 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file delta.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/delta.hpp>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(ble_utils_delta, CONFIG_BLEUTILS_LOG_LEVEL);
+
+namespace ble_utils::gatt
+{
+
+static constexpr uint16_t KEYFRAME_INTERVAL = CONFIG_BLE_UTILS_DELTA_KEYFRAME_INTERVAL;
+
+DeltaCharacteristic::DeltaCharacteristic(const bt_uuid * uuid, uint8_t props, uint8_t perm):
+    CharacteristicNotify(uuid, props, perm)
+{
+}
+
+DeltaCharacteristic::DeltaCharacteristic(const bt_uuid * uuid):
+    DeltaCharacteristic(uuid, BT_GATT_CHRC_NOTIFY, 0){}
+
+void DeltaCharacteristic::conn_ccc_written(bt_conn *conn, CCCValue_e value)
+{
+    ARG_UNUSED(value);
+    /* A client that subscribes again starts with a keyframe, the other clients keep their image */
+    resync(conn);
+}
+
+void DeltaCharacteristic::resync(bt_conn *conn)
+{
+    Peer *peer = m_peers.find(conn);
+    if (peer != nullptr) {
+        peer->synced = false;
+    }
+}
+
+int DeltaCharacteristic::notify_delta(const void *data, uint16_t len)
+{
+    if (len > MAX_LEN) {
+        return -EMSGSIZE;
+    }
+    if (m_attr == nullptr) {
+        /* The service keeps its own copy of the attributes */
+        m_attr = bt_gatt_find_by_uuid(nullptr, 0, get_uuid());
+        if (m_attr == nullptr) {
+            return -ENOENT;
+        }
+    }
+    m_data = static_cast<const uint8_t *>(data);
+    m_len = len;
+    m_err = 0;
+    bt_conn_foreach(BT_CONN_TYPE_LE, _send, this);
+    return m_err;
+}
+
+void DeltaCharacteristic::_send(bt_conn *conn, void *user_data)
+{
+    static_cast<DeltaCharacteristic *>(user_data)->send(conn);
+}
+
+void DeltaCharacteristic::send(bt_conn *conn)
+{
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+    if (!is_subscribed(conn, BT_GATT_CCC_NOTIFY)) {
+#else
+    if (!bt_gatt_is_subscribed(conn, m_attr, BT_GATT_CCC_NOTIFY)) {
+#endif
+        resync(conn);
+        return;
+    }
+    Peer &peer = m_peers.get(conn);
+    const uint16_t frame_len = encode(peer);
+    if (frame_len == 0) {
+        return;
+    }
+    const int err = bt_gatt_notify_uuid(conn, get_uuid(), nullptr, m_frame, frame_len);
+    if (err) {
+        /* The image is kept, the next frame is encoded against what the client has */
+        LOG_DBG("Delta notification failed (err %d)", err);
+        m_err = err;
+        return;
+    }
+    if (m_frame[0] & delta::FLAG_KEYFRAME) {
+        peer.synced = true;
+        peer.since_keyframe = 0;
+    } else {
+        peer.since_keyframe++;
+    }
+    peer.seq = m_frame[1];
+    peer.len = m_len;
+    memcpy(peer.image, m_data, m_len);
+}
+
+uint16_t DeltaCharacteristic::encode(const Peer &peer)
+{
+    const uint8_t seq = peer.seq + 1U;
+    const uint16_t keyframe_len = delta::HDR_SIZE + m_len;
+    m_frame[1] = seq;
+    if (peer.synced && peer.len == m_len && peer.since_keyframe + 1U < KEYFRAME_INTERVAL) {
+        uint16_t pos = delta::HDR_SIZE;
+        uint16_t i = 0;
+        while (i < m_len) {
+            if (m_data[i] == peer.image[i]) {
+                i++;
+                continue;
+            }
+            /* Extend the range over gaps that are cheaper than a new range header */
+            const uint16_t start = i;
+            uint16_t end = i + 1U;
+            for (uint16_t next = end; next < m_len && next - end <= delta::RANGE_HDR_SIZE; next++) {
+                if (m_data[next] != peer.image[next]) {
+                    end = next + 1U;
+                }
+            }
+            const uint16_t range_len = end - start;
+            if (pos + delta::RANGE_HDR_SIZE + range_len >= keyframe_len) {
+                pos = 0;
+                break;
+            }
+            m_frame[pos++] = static_cast<uint8_t>(start);
+            m_frame[pos++] = static_cast<uint8_t>(range_len);
+            memcpy(&m_frame[pos], &m_data[start], range_len);
+            pos += range_len;
+            i = end;
+        }
+        if (pos == delta::HDR_SIZE) {
+            /* Nothing changed */
+            return 0;
+        }
+        if (pos != 0) {
+            m_frame[0] = 0;
+            return pos;
+        }
+    }
+    m_frame[0] = delta::FLAG_KEYFRAME;
+    memcpy(&m_frame[delta::HDR_SIZE], m_data, m_len);
+    return keyframe_len;
+}
+
+} // namespace ble_utils::gatt
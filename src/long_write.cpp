@@ -0,0 +1,110 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file long_write.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/long_write.hpp>
+#include <zephyr/sys/bitarray.h>
+#include <string.h>
+
+namespace ble_utils::gatt
+{
+
+static constexpr size_t BLOCK_SIZE = CONFIG_BLE_UTILS_LONG_WRITE_BLOCK_SIZE;
+static constexpr size_t BLOCK_CNT = CONFIG_BLE_UTILS_LONG_WRITE_BLOCK_CNT;
+
+/*! @brief Reassembly blocks shared by all the long writable characteristics */
+static uint8_t pool[BLOCK_CNT * BLOCK_SIZE];
+SYS_BITARRAY_DEFINE_STATIC(pool_used, BLOCK_CNT);
+
+LongWriteCharacteristic::LongWriteCharacteristic(const bt_uuid * uuid, uint8_t props,
+                                                 uint8_t perm, uint16_t max_len):
+    Characteristic(uuid,
+                   props | BT_GATT_CHRC_WRITE,
+                   perm | BT_GATT_PERM_WRITE | BT_GATT_PERM_PREPARE_WRITE),
+    m_max_len(max_len),
+    m_blocks((max_len + BLOCK_SIZE - 1U) / BLOCK_SIZE),
+    m_assembly{}
+{
+    __ASSERT(max_len > 0 && m_blocks <= BLOCK_CNT, "Long write pool is smaller than the characteristic");
+}
+
+void LongWriteCharacteristic::release(uint8_t conn_idx)
+{
+    Assembly &assembly = m_assembly[conn_idx];
+    if (assembly.allocated) {
+        sys_bitarray_free(&pool_used, m_blocks, assembly.block);
+    }
+    assembly = {};
+}
+
+ssize_t LongWriteCharacteristic::conn_write_cb(bt_conn *conn, const void *buf, uint16_t len,
+                                               uint16_t offset, uint8_t flags)
+{
+    Assembly &assembly = m_assembly[bt_conn_index(conn)];
+    if (flags & BT_GATT_WRITE_FLAG_PREPARE) {
+        return prepare(assembly, buf, len, offset);
+    }
+    if ((flags & BT_GATT_WRITE_FLAG_EXECUTE) && (assembly.allocated || assembly.executed)) {
+        return execute(conn, assembly, buf, len);
+    }
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    if (len > m_max_len) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+    const ssize_t res = on_value_written(conn, buf, len);
+    return res < 0 ? res : len;
+}
+
+ssize_t LongWriteCharacteristic::prepare(Assembly &assembly, const void *buf,
+                                         uint16_t len, uint16_t offset)
+{
+    if (assembly.allocated && offset == 0) {
+        /* zephyr does not report a cancelled long write, the stale one is dropped */
+        sys_bitarray_free(&pool_used, m_blocks, assembly.block);
+        assembly = {};
+    } else if (assembly.executed) {
+        /* A new long write starts */
+        assembly = {};
+    }
+    if (offset + len > m_max_len) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+    if (!assembly.allocated) {
+        if (sys_bitarray_alloc(&pool_used, m_blocks, &assembly.block) != 0) {
+            return BT_GATT_ERR(BT_ATT_ERR_PREPARE_QUEUE_FULL);
+        }
+        assembly.allocated = true;
+        assembly.len = 0;
+    }
+    uint8_t *value = &pool[assembly.block * BLOCK_SIZE];
+    if (offset > assembly.len) {
+        /* Bytes that were not written are delivered as zeros, not as pool leftovers */
+        memset(&value[assembly.len], 0, offset - assembly.len);
+    }
+    memcpy(&value[offset], buf, len);
+    assembly.len = MAX(assembly.len, offset + len);
+    /* zephyr queues the fragment, 0 accepts it */
+    return 0;
+}
+
+ssize_t LongWriteCharacteristic::execute(bt_conn *conn, Assembly &assembly,
+                                         const void *buf, uint16_t len)
+{
+    ARG_UNUSED(buf);
+    if (assembly.executed) {
+        /* The host can execute every queued fragment, the value was already delivered */
+        return len;
+    }
+    const ssize_t res = on_value_written(conn, &pool[assembly.block * BLOCK_SIZE], assembly.len);
+    sys_bitarray_free(&pool_used, m_blocks, assembly.block);
+    assembly.allocated = false;
+    assembly.executed = true;
+    return res < 0 ? res : len;
+}
+
+} // namespace ble_utils::gatt
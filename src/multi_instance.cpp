@@ -0,0 +1,231 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file multi_instance.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/multi_instance.hpp>
+#include "trace.hpp"
+#include "backlog.hpp"
+
+namespace ble_utils::gatt
+{
+
+namespace uuid
+{
+static constexpr bt_uuid_16 PRIMARY_SVC = BT_UUID_INIT_16(BT_UUID_GATT_PRIMARY_VAL);
+static constexpr bt_uuid_16 CHRC_VAL = BT_UUID_INIT_16(BT_UUID_GATT_CHRC_VAL);
+static constexpr bt_uuid_16 CHRC_CCC = BT_UUID_INIT_16(BT_UUID_GATT_CCC_VAL);
+} // namespace uuid
+
+IServiceInstance::IServiceInstance(const ServiceTemplate &tmpl, bt_gatt_attr *attrs, InstanceCCC *ccc):
+    m_tmpl(tmpl),
+    m_attrs(attrs),
+    m_gatt_service({
+        .attrs = attrs,
+        .attr_count = tmpl.attr_cnt(),
+        .node = {nullptr}
+    }),
+    m_indicate_params({
+        .uuid = nullptr,
+        .attr = nullptr,
+#if defined(CONFIG_BLE_UTILS_TRACING) || defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+        .func = _indicate_confirm,
+#else
+        .func = nullptr,
+#endif
+        .destroy = _indicate_rsp,
+        .data = nullptr,
+        .len = 0,
+        ._ref = 0
+    })
+{
+    size_t idx = 0;
+    attrs[idx++] = {
+        .uuid = static_cast<const bt_uuid *>(static_cast<const void *>(&uuid::PRIMARY_SVC)),
+        .read = bt_gatt_attr_read_service,
+        .write = nullptr,
+        .user_data = const_cast<bt_uuid *>(tmpl.uuid),
+        .handle = 0,
+        .perm = BT_GATT_PERM_READ
+    };
+    for (uint8_t i = 0; i < tmpl.chrc_cnt; i++) {
+        const TemplateChrc &chrc = tmpl.chrcs[i];
+        /* The declaration value is shared, zephyr only reads it */
+        attrs[idx++] = {
+            .uuid = static_cast<const bt_uuid *>(static_cast<const void *>(&uuid::CHRC_VAL)),
+            .read = bt_gatt_attr_read_chrc,
+            .write = nullptr,
+            .user_data = const_cast<bt_gatt_chrc *>(&chrc.decl),
+            .handle = 0,
+            .perm = BT_GATT_PERM_READ
+        };
+        attrs[idx++] = {
+            .uuid = chrc.decl.uuid,
+            .read = _read_cb,
+            .write = _write_cb,
+            .user_data = this,
+            .handle = 0,
+            .perm = chrc.perm
+        };
+        if (chrc.has_ccc()) {
+            *ccc = {};
+            ccc->cfg_changed = _ccc_changed;
+            ccc->svc = this;
+            attrs[idx++] = {
+                .uuid = static_cast<const bt_uuid *>(static_cast<const void *>(&uuid::CHRC_CCC)),
+                .read = bt_gatt_attr_read_ccc,
+                .write = bt_gatt_attr_write_ccc,
+                .user_data = ccc++,
+                .handle = 0,
+                .perm = BT_GATT_PERM_READ | BT_GATT_PERM_WRITE
+            };
+        }
+    }
+}
+
+uint8_t IServiceInstance::chrc_index(const bt_gatt_attr *attr) const
+{
+    const size_t attr_idx = attr - m_attrs;
+    size_t idx = 1;
+    for (uint8_t i = 0; i < m_tmpl.chrc_cnt; i++) {
+        const size_t next = idx + Characteristic::attr_size + (m_tmpl.chrcs[i].has_ccc() ? 1U : 0U);
+        if (attr_idx < next) {
+            return i;
+        }
+        idx = next;
+    }
+    __ASSERT(false, "Attribute of another instance");
+    return 0;
+}
+
+const bt_gatt_attr *IServiceInstance::value_attr(uint8_t chrc) const
+{
+    __ASSERT(chrc < m_tmpl.chrc_cnt, "Invalid characteristic index");
+    size_t idx = 1;
+    for (uint8_t i = 0; i < chrc; i++) {
+        idx += Characteristic::attr_size + (m_tmpl.chrcs[i].has_ccc() ? 1U : 0U);
+    }
+    /* The value follows the declaration */
+    return &m_attrs[idx + 1];
+}
+
+int IServiceInstance::init()
+{
+    return bt_gatt_service_register(&m_gatt_service);
+}
+
+ssize_t IServiceInstance::_read_cb(bt_conn *conn, const bt_gatt_attr *attr,
+                                   void *buf, uint16_t len, uint16_t offset)
+{
+    auto instance = static_cast<IServiceInstance *>(attr->user_data);
+    trace::emit(trace::event::READ_ENTER, attr->uuid, offset);
+    const ssize_t res = instance->read_cb(conn, instance->chrc_index(attr), buf, len, offset);
+    trace::emit(trace::event::READ_EXIT, attr->uuid, static_cast<uint32_t>(res));
+    return res;
+}
+
+ssize_t IServiceInstance::_write_cb(bt_conn *conn, const bt_gatt_attr *attr,
+                                    const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+    auto instance = static_cast<IServiceInstance *>(attr->user_data);
+    trace::emit(trace::event::WRITE_ENTER, attr->uuid, len);
+    const ssize_t res = instance->write_cb(conn, instance->chrc_index(attr), buf, len, offset, flags);
+    trace::emit(trace::event::WRITE_EXIT, attr->uuid, static_cast<uint32_t>(res));
+    return res;
+}
+
+void IServiceInstance::_ccc_changed(const bt_gatt_attr *attr, uint16_t value)
+{
+    auto instance = static_cast<const InstanceCCC *>(attr->user_data)->svc;
+    const uint8_t chrc = instance->chrc_index(attr);
+    trace::emit(trace::event::CCC_CHANGED, instance->m_tmpl.chrcs[chrc].decl.uuid, value);
+    if (value > BT_GATT_CCC_INDICATE) {
+        instance->ccc_changed(chrc, ICharacteristicCCC::CCCValue_e::NA);
+    } else {
+        instance->ccc_changed(chrc, static_cast<ICharacteristicCCC::CCCValue_e>(value));
+    }
+}
+
+int IServiceInstance::notify(uint8_t chrc, const void *data, uint16_t len)
+{
+    bt_gatt_notify_params params{};
+    /* The attribute selects the instance, a UUID lookup would find the first one */
+    params.attr = value_attr(chrc);
+    params.data = data;
+    params.len = len;
+#if defined(CONFIG_BLE_UTILS_TRACING) || defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+    params.func = _notify_sent;
+    params.user_data = trace::seq_data(trace::next_seq());
+#endif
+    const int gatt_res = bt_gatt_notify_cb(nullptr, &params);
+    if (gatt_res == 0) {
+        trace::emit_submit(trace::event::NOTIFY_SUBMIT, params.attr->uuid,
+                           trace::seq_of(params.user_data), len);
+        conn::backlog::submitted(params.attr, BT_GATT_CCC_NOTIFY, len);
+    }
+    return gatt_res;
+}
+
+#if defined(CONFIG_BLE_UTILS_TRACING) || defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+void IServiceInstance::_notify_sent(bt_conn *conn, void *user_data)
+{
+    trace::emit_done(trace::event::NOTIFY_DONE, trace::seq_of(user_data), conn);
+    conn::backlog::completed(conn);
+}
+#endif
+
+int IServiceInstance::indicate(uint8_t chrc, const void *data, uint16_t len)
+{
+    if (m_indicate_pending) {
+        return -EBUSY;
+    }
+    m_indicate_params.attr = value_attr(chrc);
+    m_indicate_params.data = data;
+    m_indicate_params.len = len;
+#if defined(CONFIG_BLE_UTILS_TRACING)
+    m_trace_seq = trace::next_seq();
+#endif
+    m_indicate_pending = true;
+    const int gatt_res = bt_gatt_indicate(nullptr, &m_indicate_params);
+    if (gatt_res != 0) {
+        m_indicate_pending = false;
+    } else {
+#if defined(CONFIG_BLE_UTILS_TRACING)
+        trace::emit_submit(trace::event::INDICATE_SUBMIT, m_indicate_params.attr->uuid, m_trace_seq, len);
+#endif
+        conn::backlog::submitted(m_indicate_params.attr, BT_GATT_CCC_INDICATE, len);
+    }
+    return gatt_res;
+}
+
+#if defined(CONFIG_BLE_UTILS_TRACING) || defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+void IServiceInstance::_indicate_confirm(bt_conn *conn, bt_gatt_indicate_params *params, uint8_t err)
+{
+#if defined(CONFIG_BLE_UTILS_TRACING)
+    auto instance = static_cast<IServiceInstance *>(params->attr->user_data);
+    if (err == 0) {
+        trace::emit_done(trace::event::INDICATE_CONFIRM, instance->m_trace_seq, conn);
+    }
+#else
+    ARG_UNUSED(params);
+    ARG_UNUSED(err);
+#endif
+    conn::backlog::completed(conn);
+}
+#endif
+
+void IServiceInstance::_indicate_rsp(bt_gatt_indicate_params *params)
+{
+    auto instance = static_cast<IServiceInstance *>(params->attr->user_data);
+    instance->m_indicate_pending = false;
+    instance->indicate_rsp(instance->chrc_index(params->attr));
+}
+
+bool IServiceInstance::is_subscribed(bt_conn *conn, uint8_t chrc, uint16_t type) const
+{
+    return bt_gatt_is_subscribed(conn, value_attr(chrc), type);
+}
+
+} // namespace ble_utils::gatt
@@ -0,0 +1,103 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file notify_router.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/notify_router.hpp>
+#include <zephyr/sys/util.h>
+
+namespace ble_utils::client
+{
+
+NotificationRouter::NotificationRouter():
+    m_subs{}
+{
+}
+
+NotificationRouter::Subscription * NotificationRouter::find(uint8_t conn_idx,
+                                                            uint16_t value_handle)
+{
+    for (auto &sub : m_subs[conn_idx]) {
+        if (sub.handler != nullptr && sub.params.value_handle == value_handle) {
+            return &sub;
+        }
+    }
+    return nullptr;
+}
+
+int NotificationRouter::subscribe(bt_conn *conn, uint16_t value_handle, uint16_t ccc_handle,
+                                  uint16_t ccc_value, INotificationHandler &handler)
+{
+    const uint8_t conn_idx = bt_conn_index(conn);
+    if (find(conn_idx, value_handle) != nullptr) {
+        return -EALREADY;
+    }
+    Subscription *sub = nullptr;
+    for (auto &candidate : m_subs[conn_idx]) {
+        if (candidate.handler == nullptr) {
+            sub = &candidate;
+            break;
+        }
+    }
+    if (sub == nullptr) {
+        return -ENOMEM;
+    }
+    sub->params = {};
+    sub->params.notify = _notify_cb;
+    sub->params.subscribe = _subscribe_cb;
+    sub->params.value_handle = value_handle;
+    sub->params.ccc_handle = ccc_handle;
+    sub->params.value = ccc_value;
+    sub->handler = &handler;
+    const int err = bt_gatt_subscribe(conn, &sub->params);
+    if (err) {
+        sub->handler = nullptr;
+    }
+    return err;
+}
+
+int NotificationRouter::unsubscribe(bt_conn *conn, uint16_t value_handle)
+{
+    Subscription *sub = find(bt_conn_index(conn), value_handle);
+    if (sub == nullptr) {
+        return -ENOENT;
+    }
+    /* The slot is released when zephyr reports the removal */
+    return bt_gatt_unsubscribe(conn, &sub->params);
+}
+
+void NotificationRouter::release(bt_conn *conn, Subscription &sub)
+{
+    INotificationHandler *handler = sub.handler;
+    const uint16_t value_handle = sub.params.value_handle;
+    sub.handler = nullptr;
+    sub.params.value_handle = 0;
+    if (handler != nullptr) {
+        handler->unsubscribed(conn, value_handle);
+    }
+}
+
+uint8_t NotificationRouter::_notify_cb(bt_conn *conn, bt_gatt_subscribe_params *params,
+                                       const void *data, uint16_t length)
+{
+    Subscription *sub = CONTAINER_OF(params, Subscription, params);
+    if (data == nullptr) {
+        release(conn, *sub);
+        return BT_GATT_ITER_STOP;
+    }
+    sub->handler->notification(conn, params->value_handle, data, length);
+    return BT_GATT_ITER_CONTINUE;
+}
+
+void NotificationRouter::_subscribe_cb(bt_conn *conn, uint8_t err,
+                                       bt_gatt_subscribe_params *params)
+{
+    if (err && params->value != 0) {
+        /* zephyr removed the subscription, the CCC could not be written */
+        release(conn, *CONTAINER_OF(params, Subscription, params));
+    }
+}
+
+} // namespace ble_utils::client
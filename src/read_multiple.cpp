@@ -0,0 +1,134 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file read_multiple.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/read_multiple.hpp>
+#include <zephyr/sys/util.h>
+
+namespace ble_utils::client
+{
+
+ReadMultiple::ReadMultiple(const Item *items, size_t cnt):
+    m_items(items),
+    m_cnt(cnt),
+    m_handles{},
+    m_params{{}, this}
+{
+}
+
+int ReadMultiple::read(bt_conn *conn)
+{
+    if (m_busy) {
+        return -EBUSY;
+    }
+    m_busy = true;
+    m_first = 0;
+    m_chunk = 0;
+    const int err = next(conn);
+    if (err) {
+        m_busy = false;
+    }
+    return err;
+}
+
+int ReadMultiple::next(bt_conn *conn)
+{
+    m_first += m_chunk;
+    m_chunk = 0;
+    m_value = 0;
+    if (m_first >= m_cnt) {
+        finish(0);
+        return 0;
+    }
+    /* Both the request (handles) and the response must fit into the ATT payload */
+    const size_t payload = bt_gatt_get_mtu(conn) - 1U;
+    const bool variable = m_items[m_first].variable;
+    size_t rsp_len = 0;
+    size_t cnt = 0;
+    while (m_first + cnt < m_cnt && cnt < MAX_HANDLES) {
+        const Item &item = m_items[m_first + cnt];
+        const size_t item_len = variable ? sizeof(uint16_t) + item.len : item.len;
+        if (item.variable != variable ||
+            (cnt + 1U) * sizeof(uint16_t) > payload ||
+            (cnt > 0 && rsp_len + item_len > payload)) {
+            break;
+        }
+        m_handles[cnt++] = item.handle;
+        rsp_len += item_len;
+    }
+#if !defined(CONFIG_BT_GATT_READ_MULT_VAR_LEN)
+    if (variable) {
+        cnt = 1;
+    }
+#endif
+#if !defined(CONFIG_BT_GATT_READ_MULTIPLE)
+    if (!variable) {
+        cnt = 1;
+    }
+#endif
+    m_chunk = cnt;
+    m_params.params = {};
+    m_params.params.func = _read_cb;
+    m_params.params.handle_count = cnt;
+    if (cnt == 1) {
+        m_params.params.single.handle = m_handles[0];
+        m_params.params.single.offset = 0;
+    } else {
+        m_params.params.multiple.handles = m_handles;
+        m_params.params.multiple.variable = variable;
+    }
+    return bt_gatt_read(conn, &m_params.params);
+}
+
+void ReadMultiple::finish(int err)
+{
+    m_busy = false;
+    read_done(err);
+}
+
+uint8_t ReadMultiple::_read_cb(bt_conn *conn, uint8_t err, bt_gatt_read_params *params,
+                               const void *data, uint16_t length)
+{
+    auto instance = CONTAINER_OF(params, Params, params)->self;
+    return instance->read_cb(conn, err, data, length);
+}
+
+uint8_t ReadMultiple::read_cb(bt_conn *conn, uint8_t err, const void *data, uint16_t length)
+{
+    if (err) {
+        finish(err);
+        return BT_GATT_ITER_STOP;
+    }
+    if (data != nullptr) {
+        if (m_chunk == 1) {
+            /* Long values are not continued with read blob */
+            value_read(m_first, data, length);
+        } else if (m_params.params.multiple.variable) {
+            if (m_value < m_chunk) {
+                value_read(m_first + m_value, data, length);
+                m_value++;
+            }
+            return BT_GATT_ITER_CONTINUE;
+        } else {
+            /* Read Multiple responds with the concatenated values */
+            const uint8_t *buf = static_cast<const uint8_t *>(data);
+            uint16_t pos = 0;
+            for (; m_value < m_chunk && pos < length; m_value++) {
+                const uint16_t len = MIN(m_items[m_first + m_value].len, length - pos);
+                value_read(m_first + m_value, &buf[pos], len);
+                pos += len;
+            }
+            return BT_GATT_ITER_CONTINUE;
+        }
+    }
+    const int next_err = next(conn);
+    if (next_err) {
+        finish(next_err);
+    }
+    return BT_GATT_ITER_STOP;
+}
+
+} // namespace ble_utils::client
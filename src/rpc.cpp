@@ -0,0 +1,282 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file rpc.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/rpc.hpp>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(ble_utils_rpc, CONFIG_BLEUTILS_LOG_LEVEL);
+
+namespace ble_utils::gatt
+{
+
+/*! @brief Retry delay when no notification buffers are available */
+static constexpr uint32_t RETRY_DELAY_MS{1U};
+
+RpcCharacteristic::RpcCharacteristic(const bt_uuid * uuid, const rpc::Handler *handlers,
+                                     size_t handler_cnt, rpc::Order order, void *ctx):
+    CharacteristicNotify(uuid,
+                         BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+                         BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+    m_handlers(handlers),
+    m_handler_cnt(handler_cnt),
+    m_order(order),
+    m_ctx(ctx),
+    m_slots{},
+    m_lock{},
+    m_work{{}, this}
+{
+    k_work_init_delayable(&m_work.work, _work_handler);
+}
+
+ssize_t RpcCharacteristic::read_cb(void *buf, uint16_t len, uint16_t offset)
+{
+    uint8_t info[sizeof(uint8_t) + 2 * sizeof(uint16_t)];
+    info[0] = rpc::MAX_INFLIGHT;
+    sys_put_le16(rpc::MAX_REQ_LEN, &info[1]);
+    sys_put_le16(rpc::MAX_RSP_LEN, &info[3]);
+    if (offset > sizeof(info)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    const uint16_t read_len = MIN(len, sizeof(info) - offset);
+    memcpy(buf, &info[offset], read_len);
+    return read_len;
+}
+
+ssize_t RpcCharacteristic::conn_write_cb(bt_conn *conn, const void *buf, uint16_t len,
+                                         uint16_t offset, uint8_t flags)
+{
+    ARG_UNUSED(flags);
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    if (len < rpc::REQ_HDR_SIZE || len > rpc::REQ_HDR_SIZE + rpc::MAX_REQ_LEN) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+    const uint8_t conn_idx = bt_conn_index(conn);
+    Slot *slot = nullptr;
+    k_spinlock_key_t key = k_spin_lock(&m_lock);
+    for (auto &candidate : m_slots[conn_idx]) {
+        if (candidate.state == SlotState::Free) {
+            slot = &candidate;
+            /* Reserve the slot, it is queued once the request is copied */
+            slot->state = SlotState::Reserved;
+            slot->dropped = false;
+            slot->order = m_arrival++;
+            break;
+        }
+    }
+    k_spin_unlock(&m_lock, key);
+    if (slot == nullptr) {
+        LOG_WRN("RPC window exceeded, request dropped");
+        return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+    }
+    memcpy(slot->req, buf, len);
+    slot->req_len = len;
+    slot->rsp_len = 0;
+    slot->conn = bt_conn_ref(conn);
+    key = k_spin_lock(&m_lock);
+    slot->state = SlotState::Queued;
+    k_spin_unlock(&m_lock, key);
+    k_work_schedule(&m_work.work, K_NO_WAIT);
+    return len;
+}
+
+rpc::HandlerFunc RpcCharacteristic::find_handler(uint8_t opcode) const
+{
+    size_t low = 0;
+    size_t high = m_handler_cnt;
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2U;
+        if (m_handlers[mid].opcode == opcode) {
+            return m_handlers[mid].func;
+        }
+        if (m_handlers[mid].opcode < opcode) {
+            low = mid + 1U;
+        } else {
+            high = mid;
+        }
+    }
+    return nullptr;
+}
+
+RpcCharacteristic::Slot * RpcCharacteristic::next_queued(uint8_t &conn_idx, uint8_t &slot_idx)
+{
+    Slot *next = nullptr;
+    k_spinlock_key_t key = k_spin_lock(&m_lock);
+    for (uint8_t c = 0; c < CONFIG_BT_MAX_CONN; c++) {
+        for (uint8_t i = 0; i < rpc::MAX_INFLIGHT; i++) {
+            Slot &slot = m_slots[c][i];
+            if (slot.state == SlotState::Queued && !slot.dropped &&
+                (next == nullptr || static_cast<int32_t>(slot.order - next->order) < 0)) {
+                next = &slot;
+                conn_idx = c;
+                slot_idx = i;
+            }
+        }
+    }
+    if (next != nullptr) {
+        next->state = SlotState::Pending;
+    }
+    k_spin_unlock(&m_lock, key);
+    return next;
+}
+
+void RpcCharacteristic::execute(uint8_t conn_idx, uint8_t slot_idx)
+{
+    Slot &slot = m_slots[conn_idx][slot_idx];
+    const uint8_t opcode = slot.req[1];
+    slot.rsp[0] = slot.req[0];
+    slot.rsp[1] = opcode;
+    const rpc::HandlerFunc func = find_handler(opcode);
+    if (func == nullptr) {
+        finish(slot, rpc::Status::UnknownOpcode, 0);
+        return;
+    }
+    const rpc::Request req {
+        .conn = slot.conn,
+        .ctx = m_ctx,
+        .token = {
+            .conn_idx = conn_idx,
+            .slot = slot_idx,
+            .seq = slot.req[0]
+        },
+        .opcode = opcode,
+        .data = &slot.req[rpc::REQ_HDR_SIZE],
+        .len = static_cast<uint16_t>(slot.req_len - rpc::REQ_HDR_SIZE)
+    };
+    rpc::Response rsp {
+        .data = &slot.rsp[rpc::RSP_HDR_SIZE],
+        .max_len = rpc::MAX_RSP_LEN,
+        .len = 0
+    };
+    const rpc::Status status = func(req, rsp);
+    if (status != rpc::Status::Pending) {
+        finish(slot, status, MIN(rsp.len, rpc::MAX_RSP_LEN));
+    }
+}
+
+void RpcCharacteristic::finish(Slot &slot, rpc::Status status, uint16_t rsp_len)
+{
+    slot.rsp[2] = static_cast<uint8_t>(status);
+    slot.rsp_len = rsp_len;
+    k_spinlock_key_t key = k_spin_lock(&m_lock);
+    slot.state = SlotState::Done;
+    k_spin_unlock(&m_lock, key);
+}
+
+int RpcCharacteristic::complete(const rpc::Token &token, rpc::Status status,
+                                const void *data, uint16_t len)
+{
+    if (token.conn_idx >= CONFIG_BT_MAX_CONN || token.slot >= rpc::MAX_INFLIGHT ||
+        status == rpc::Status::Pending) {
+        return -EINVAL;
+    }
+    if (len > rpc::MAX_RSP_LEN) {
+        return -EMSGSIZE;
+    }
+    Slot &slot = m_slots[token.conn_idx][token.slot];
+    if (slot.state != SlotState::Pending || slot.req[0] != token.seq) {
+        return -EINVAL;
+    }
+    /* Read before the slot is handed to the work queue, which can free and reuse it */
+    const bool dropped = slot.dropped;
+    memcpy(&slot.rsp[rpc::RSP_HDR_SIZE], data, len);
+    finish(slot, status, len);
+    k_work_schedule(&m_work.work, K_NO_WAIT);
+    return dropped ? -ENOTCONN : 0;
+}
+
+void RpcCharacteristic::release(uint8_t conn_idx)
+{
+    /* Slots can be in use by the work queue, they are freed by the work handler */
+    k_spinlock_key_t key = k_spin_lock(&m_lock);
+    for (auto &slot : m_slots[conn_idx]) {
+        if (slot.state != SlotState::Free) {
+            slot.dropped = true;
+        }
+    }
+    k_spin_unlock(&m_lock, key);
+    k_work_schedule(&m_work.work, K_NO_WAIT);
+}
+
+void RpcCharacteristic::discard()
+{
+    for (auto &conn_slots : m_slots) {
+        for (auto &slot : conn_slots) {
+            /* Pending requests are freed once their handler completes */
+            if (slot.dropped && (slot.state == SlotState::Queued || slot.state == SlotState::Done)) {
+                free_slot(slot);
+            }
+        }
+    }
+}
+
+RpcCharacteristic::Slot * RpcCharacteristic::oldest(uint8_t conn_idx, bool done_only)
+{
+    Slot *result = nullptr;
+    for (auto &slot : m_slots[conn_idx]) {
+        if (slot.state == SlotState::Free || slot.dropped ||
+            (done_only && slot.state != SlotState::Done)) {
+            continue;
+        }
+        if (result == nullptr || static_cast<int32_t>(slot.order - result->order) < 0) {
+            result = &slot;
+        }
+    }
+    return result;
+}
+
+void RpcCharacteristic::free_slot(Slot &slot)
+{
+    bt_conn_unref(slot.conn);
+    slot.conn = nullptr;
+    k_spinlock_key_t key = k_spin_lock(&m_lock);
+    slot.state = SlotState::Free;
+    k_spin_unlock(&m_lock, key);
+}
+
+bool RpcCharacteristic::flush()
+{
+    const bool done_only = m_order == rpc::Order::OutOfOrder;
+    for (uint8_t c = 0; c < CONFIG_BT_MAX_CONN; c++) {
+        Slot *slot;
+        while ((slot = oldest(c, done_only)) != nullptr && slot->state == SlotState::Done) {
+            const int err = bt_gatt_notify_uuid(slot->conn,
+                                                get_uuid(),
+                                                nullptr,
+                                                slot->rsp,
+                                                rpc::RSP_HDR_SIZE + slot->rsp_len);
+            if (err == -ENOMEM) {
+                return false;
+            }
+            if (err) {
+                LOG_WRN("RPC response dropped (err %d)", err);
+            }
+            free_slot(*slot);
+        }
+    }
+    return true;
+}
+
+void RpcCharacteristic::_work_handler(k_work *work)
+{
+    k_work_delayable *dwork = k_work_delayable_from_work(work);
+    auto instance = CONTAINER_OF(dwork, Work, work)->rpc;
+    uint8_t conn_idx;
+    uint8_t slot_idx;
+    while (instance->next_queued(conn_idx, slot_idx) != nullptr) {
+        instance->execute(conn_idx, slot_idx);
+    }
+    instance->discard();
+    if (!instance->flush()) {
+        k_work_schedule(&instance->m_work.work, K_MSEC(RETRY_DELAY_MS));
+    }
+}
+
+} // namespace ble_utils::gatt
@@ -0,0 +1,180 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file scanner.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/scanner.hpp>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+
+namespace ble_utils::scan
+{
+
+static constexpr uint32_t DUP_WINDOW_MS = CONFIG_BLE_UTILS_SCANNER_DUP_WINDOW_MS;
+
+/*! @brief Size of the AD element header (length and type) */
+static constexpr uint8_t AD_HDR_SIZE{2U};
+
+static Scanner * active_scanner;
+static bt_le_scan_cb scan_callbacks;
+
+template<typename T>
+static bool search(const T *table, size_t cnt, T value)
+{
+    size_t low = 0;
+    size_t high = cnt;
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2U;
+        if (table[mid] == value) {
+            return true;
+        }
+        if (table[mid] < value) {
+            low = mid + 1U;
+        } else {
+            high = mid;
+        }
+    }
+    return false;
+}
+
+static bool search128(const uint8_t (*table)[BT_UUID_SIZE_128], size_t cnt, const uint8_t *value)
+{
+    size_t low = 0;
+    size_t high = cnt;
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2U;
+        const int cmp = memcmp(table[mid], value, BT_UUID_SIZE_128);
+        if (cmp == 0) {
+            return true;
+        }
+        if (cmp < 0) {
+            low = mid + 1U;
+        } else {
+            high = mid;
+        }
+    }
+    return false;
+}
+
+bool FilterTable::match(uint8_t type, const uint8_t *data, uint8_t len) const
+{
+    switch (type) {
+    case BT_DATA_UUID16_SOME:
+    case BT_DATA_UUID16_ALL:
+        for (uint8_t i = 0; i + BT_UUID_SIZE_16 <= len; i += BT_UUID_SIZE_16) {
+            if (search(uuid16, cnt16, sys_get_le16(&data[i]))) {
+                return true;
+            }
+        }
+        break;
+    case BT_DATA_UUID32_SOME:
+    case BT_DATA_UUID32_ALL:
+        for (uint8_t i = 0; i + BT_UUID_SIZE_32 <= len; i += BT_UUID_SIZE_32) {
+            if (search(uuid32, cnt32, sys_get_le32(&data[i]))) {
+                return true;
+            }
+        }
+        break;
+    case BT_DATA_UUID128_SOME:
+    case BT_DATA_UUID128_ALL:
+        for (uint8_t i = 0; i + BT_UUID_SIZE_128 <= len; i += BT_UUID_SIZE_128) {
+            if (search128(uuid128, cnt128, &data[i])) {
+                return true;
+            }
+        }
+        break;
+    case BT_DATA_SVC_DATA16:
+        return len >= BT_UUID_SIZE_16 && search(uuid16, cnt16, sys_get_le16(data));
+    case BT_DATA_SVC_DATA32:
+        return len >= BT_UUID_SIZE_32 && search(uuid32, cnt32, sys_get_le32(data));
+    case BT_DATA_SVC_DATA128:
+        return len >= BT_UUID_SIZE_128 && search128(uuid128, cnt128, data);
+    default:
+        break;
+    }
+    return false;
+}
+
+Scanner::Scanner(const FilterTable &filter):
+    m_filter(filter),
+    m_dup_cache{}
+{
+}
+
+int Scanner::start(const bt_le_scan_param &param)
+{
+    if (scan_callbacks.recv == nullptr) {
+        scan_callbacks.recv = _recv;
+        bt_le_scan_cb_register(&scan_callbacks);
+    }
+    for (auto &entry : m_dup_cache) {
+        entry.valid = false;
+    }
+    active_scanner = this;
+    const int res = bt_le_scan_start(&param, nullptr);
+    if (res != 0) {
+        active_scanner = nullptr;
+    }
+    return res;
+}
+
+int Scanner::stop()
+{
+    active_scanner = nullptr;
+    return bt_le_scan_stop();
+}
+
+bool Scanner::matches(const net_buf_simple *ad) const
+{
+    const uint8_t *data = ad->data;
+    uint16_t remaining = ad->len;
+    while (remaining > 1U) {
+        const uint8_t len = data[0];
+        /* Length 0 marks the early end of the AD data */
+        if (len == 0U || len >= remaining) {
+            return false;
+        }
+        if (m_filter.match(data[1], &data[AD_HDR_SIZE], len - 1U)) {
+            return true;
+        }
+        data += len + 1U;
+        remaining -= len + 1U;
+    }
+    return false;
+}
+
+bool Scanner::is_duplicate(const bt_le_scan_recv_info *info)
+{
+    const uint32_t now = k_uptime_get_32();
+    for (auto &entry : m_dup_cache) {
+        if (entry.valid && bt_addr_le_cmp(&entry.addr, info->addr) == 0) {
+            if (now - entry.timestamp < DUP_WINDOW_MS) {
+                return true;
+            }
+            entry.timestamp = now;
+            return false;
+        }
+    }
+    DupEntry &entry = m_dup_cache[m_dup_next];
+    m_dup_next = (m_dup_next + 1U) % DUP_CACHE_SIZE;
+    bt_addr_le_copy(&entry.addr, info->addr);
+    entry.timestamp = now;
+    entry.valid = true;
+    return false;
+}
+
+void Scanner::_recv(const bt_le_scan_recv_info *info, net_buf_simple *buf)
+{
+    Scanner *instance = active_scanner;
+    if (instance == nullptr || !instance->matches(buf)) {
+        return;
+    }
+    if (instance->is_duplicate(info)) {
+        return;
+    }
+    instance->device_found(info, buf);
+}
+
+} // namespace ble_utils::scan
@@ -0,0 +1,50 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file session.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/session.hpp>
+
+namespace ble_utils::gatt
+{
+
+/*! @brief Head of the registered session pools */
+static ISessionPool * pools;
+static bt_conn_cb conn_callbacks;
+
+static void disconnected(bt_conn *conn, uint8_t reason)
+{
+    ARG_UNUSED(reason);
+    release_sessions(bt_conn_index(conn));
+}
+
+ISessionPool::ISessionPool():
+    m_next(pools)
+{
+    if (conn_callbacks.disconnected == nullptr) {
+        conn_callbacks.disconnected = disconnected;
+        bt_conn_cb_register(&conn_callbacks);
+    }
+    pools = this;
+}
+
+ISessionPool::~ISessionPool()
+{
+    for (ISessionPool **it = &pools; *it != nullptr; it = &(*it)->m_next) {
+        if (*it == this) {
+            *it = m_next;
+            break;
+        }
+    }
+}
+
+void release_sessions(uint8_t conn_idx)
+{
+    for (ISessionPool *pool = pools; pool != nullptr; pool = pool->m_next) {
+        pool->release(conn_idx);
+    }
+}
+
+} // namespace ble_utils::gatt
@@ -0,0 +1,220 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file snapshot.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/snapshot.hpp>
+#include "backlog.hpp"
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(ble_utils_snapshot, CONFIG_BLEUTILS_LOG_LEVEL);
+
+namespace ble_utils::gatt
+{
+
+/*! @brief Read permissions a value can require */
+static constexpr uint16_t READ_PERM_MASK{BT_GATT_PERM_READ | BT_GATT_PERM_READ_ENCRYPT |
+                                         BT_GATT_PERM_READ_AUTHEN | BT_GATT_PERM_READ_LESC};
+/*! @brief Size of the ATT notification header */
+static constexpr uint16_t NOTIFY_HDR_SIZE{3U};
+/*! @brief Retry delay when no notification buffers are available */
+static constexpr uint32_t RETRY_MS{1U};
+
+/**
+ * @brief Context to look up a connection by its index
+ */
+struct ConnLookup
+{
+    uint8_t idx;
+    bt_conn *conn;
+};
+
+static void lookup_conn(bt_conn *conn, void *data)
+{
+    auto ctx = static_cast<ConnLookup *>(data);
+    if (bt_conn_index(conn) == ctx->idx) {
+        ctx->conn = bt_conn_ref(conn);
+    }
+}
+
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+static void notify_sent(bt_conn *conn, void *user_data)
+{
+    ARG_UNUSED(user_data);
+    conn::backlog::completed(conn);
+}
+#endif
+
+Snapshot::Snapshot(const bt_uuid * uuid, Service &svc, uint8_t perm):
+    CharacteristicNotify(uuid, BT_GATT_CHRC_READ, perm | BT_GATT_PERM_READ),
+    m_svc(svc),
+    m_pending{},
+    m_work{{}, this}
+{
+    k_work_init_delayable(&m_work.work, _notify_handler);
+}
+
+uint16_t Snapshot::build(bt_conn *conn, uint8_t *buf) const
+{
+    const bt_gatt_attr *attrs = m_svc.m_gatt_service.attrs;
+    const void *self = static_cast<const Characteristic *>(this);
+    const uint16_t perm = m_attr_value.perm;
+    uint16_t pos = 0;
+    for (size_t i = 0; i < m_svc.m_gatt_service.attr_count; i++) {
+        const bt_gatt_attr &attr = attrs[i];
+        if (attr.read != Characteristic::_read_cb || attr.user_data == self) {
+            continue;
+        }
+        auto chrc = static_cast<Characteristic *>(attr.user_data);
+        if ((chrc->m_gatt_chrc.properties & BT_GATT_CHRC_READ) == 0 ||
+            (attr.perm & READ_PERM_MASK & ~perm) != 0) {
+            continue;
+        }
+        if (MAX_LEN - pos <= snapshot::ENTRY_HDR_SIZE) {
+            break;
+        }
+        const uint16_t room = MAX_LEN - pos - snapshot::ENTRY_HDR_SIZE;
+        /* The spare byte of the buffer tells a value that fits from a truncated one */
+        const ssize_t res = chrc->conn_read_cb(conn, &buf[pos + snapshot::ENTRY_HDR_SIZE], room + 1, 0);
+        if (res < 0 || res > room) {
+            continue;
+        }
+        sys_put_le16(attr.handle, &buf[pos]);
+        sys_put_le16(static_cast<uint16_t>(res), &buf[pos + 2]);
+        pos += snapshot::ENTRY_HDR_SIZE + static_cast<uint16_t>(res);
+    }
+    return pos;
+}
+
+const bt_gatt_attr *Snapshot::value_attr() const
+{
+    const bt_gatt_attr *attrs = m_svc.m_gatt_service.attrs;
+    const void *self = static_cast<const Characteristic *>(this);
+    for (size_t i = 0; i < m_svc.m_gatt_service.attr_count; i++) {
+        if (attrs[i].read == Characteristic::_read_cb && attrs[i].user_data == self) {
+            return &attrs[i];
+        }
+    }
+    return nullptr;
+}
+
+ssize_t Snapshot::conn_read_cb(bt_conn *conn, void *buf, uint16_t len, uint16_t offset)
+{
+    const uint8_t idx = bt_conn_index(conn);
+    /* A new read starts at offset 0, the blob reads that follow get the same snapshot */
+    if (offset == 0) {
+        m_read_len[idx] = build(conn, m_read_buf[idx]);
+    }
+    if (offset > m_read_len[idx]) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    const uint16_t read_len = MIN(len, m_read_len[idx] - offset);
+    memcpy(buf, &m_read_buf[idx][offset], read_len);
+    return read_len;
+}
+
+void Snapshot::conn_ccc_written(bt_conn *conn, CCCValue_e value)
+{
+    if (value != CCCValue_e::Notify) {
+        return;
+    }
+    atomic_set_bit(m_pending, bt_conn_index(conn));
+    /* The host stores the value before this returns to it, the BT RX context is cooperative */
+    k_work_schedule(&m_work.work, K_NO_WAIT);
+}
+
+int Snapshot::send()
+{
+    ConnLookup ctx{m_tx_idx, nullptr};
+    bt_conn_foreach(BT_CONN_TYPE_LE, lookup_conn, &ctx);
+    if (ctx.conn == nullptr) {
+        return 0;
+    }
+    const bt_gatt_attr *attr = value_attr();
+#if defined(CONFIG_BLE_UTILS_CCC_COMPACT)
+    const bool subscribed = is_subscribed(ctx.conn, BT_GATT_CCC_NOTIFY);
+#else
+    const bool subscribed = bt_gatt_is_subscribed(ctx.conn, attr, BT_GATT_CCC_NOTIFY);
+#endif
+    if (!subscribed) {
+        /* Unsubscribed again before the snapshot was sent */
+        bt_conn_unref(ctx.conn);
+        return 0;
+    }
+    const uint16_t payload = bt_gatt_get_mtu(ctx.conn) - NOTIFY_HDR_SIZE;
+    int err = 0;
+    while (m_tx_pos < m_tx_len) {
+        /* Pack complete entries into the notification */
+        uint16_t end = m_tx_pos;
+        while (end < m_tx_len) {
+            const uint16_t entry = snapshot::ENTRY_HDR_SIZE + sys_get_le16(&m_tx_buf[end + 2]);
+            if (end - m_tx_pos + entry > payload) {
+                break;
+            }
+            end += entry;
+        }
+        if (end == m_tx_pos) {
+            /* The entry does not fit into a notification, the client reads the value */
+            m_tx_pos += snapshot::ENTRY_HDR_SIZE + sys_get_le16(&m_tx_buf[m_tx_pos + 2]);
+            continue;
+        }
+        bt_gatt_notify_params params{};
+        params.attr = attr;
+        params.data = &m_tx_buf[m_tx_pos];
+        params.len = end - m_tx_pos;
+#if defined(CONFIG_BLE_UTILS_CONN_ADAPTIVE)
+        params.func = notify_sent;
+#endif
+        err = bt_gatt_notify_cb(ctx.conn, &params);
+        if (err) {
+            break;
+        }
+        conn::backlog::submitted(ctx.conn, params.len);
+        m_tx_pos = end;
+    }
+    bt_conn_unref(ctx.conn);
+    if (err && err != -ENOMEM) {
+        LOG_DBG("Snapshot notification failed (err %d)", err);
+        return 0;
+    }
+    return err;
+}
+
+void Snapshot::_notify_handler(k_work *work)
+{
+    k_work_delayable *dwork = k_work_delayable_from_work(work);
+    auto instance = CONTAINER_OF(dwork, NotifyWork, work)->chrc;
+    for (;;) {
+        if (instance->m_tx_idx == TX_IDLE) {
+            uint8_t idx = 0;
+            while (idx < CONFIG_BT_MAX_CONN && !atomic_test_and_clear_bit(instance->m_pending, idx)) {
+                idx++;
+            }
+            if (idx == CONFIG_BT_MAX_CONN) {
+                return;
+            }
+            ConnLookup ctx{idx, nullptr};
+            bt_conn_foreach(BT_CONN_TYPE_LE, lookup_conn, &ctx);
+            if (ctx.conn == nullptr) {
+                continue;
+            }
+            instance->m_tx_idx = idx;
+            instance->m_tx_len = instance->build(ctx.conn, instance->m_tx_buf);
+            instance->m_tx_pos = 0;
+            bt_conn_unref(ctx.conn);
+        }
+        const int err = instance->send();
+        if (err == -ENOMEM) {
+            k_work_schedule(dwork, K_MSEC(RETRY_MS));
+            return;
+        }
+        instance->m_tx_idx = TX_IDLE;
+    }
+}
+
+} // namespace ble_utils::gatt
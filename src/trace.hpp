@@ -0,0 +1,199 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file trace.hpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Internal tracing hooks for the GATT hot path. The events are emitted as
+* Zephyr named events, which the CTF backend records with a timestamp.
+* See scripts/ctf_latency.py to evaluate a trace.
+********************************************************************/
+
+#pragma once
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+#include <stdint.h>
+
+#if defined(CONFIG_BLE_UTILS_TRACING)
+#include <zephyr/tracing/tracing.h>
+#endif
+
+namespace ble_utils::trace
+{
+
+/**
+ * @brief Names of the traced events
+ * @details Names are limited to 20 characters by the CTF named event.
+ *          Keep in sync with scripts/ctf_latency.py
+ */
+namespace event
+{
+static constexpr const char * READ_ENTER{"bleu_read_enter"};
+static constexpr const char * READ_EXIT{"bleu_read_exit"};
+static constexpr const char * WRITE_ENTER{"bleu_write_enter"};
+static constexpr const char * WRITE_EXIT{"bleu_write_exit"};
+static constexpr const char * NOTIFY_SUBMIT{"bleu_notify_submit"};
+static constexpr const char * NOTIFY_DONE{"bleu_notify_done"};
+static constexpr const char * INDICATE_SUBMIT{"bleu_ind_submit"};
+static constexpr const char * INDICATE_CONFIRM{"bleu_ind_confirm"};
+static constexpr const char * CCC_CHANGED{"bleu_ccc_changed"};
+static constexpr const char * CONN_PARAM{"bleu_conn_param"};
+} // namespace event
+
+/**
+ * @brief Identity of a characteristic in the trace
+ * @details 16 and 32 bit UUIDs are used as is. For 128 bit UUIDs the most
+ *          significant 32 bits are used, which contain the short UUID of
+ *          UUIDs created with ble_utils::uuid::derive_uuid.
+ *
+ * @param uuid UUID of the characteristic
+ * @return 32 bit identifier
+ */
+static inline uint32_t id(const bt_uuid *uuid)
+{
+    switch (uuid->type) {
+    case BT_UUID_TYPE_16:
+        return BT_UUID_16(uuid)->val;
+    case BT_UUID_TYPE_32:
+        return BT_UUID_32(uuid)->val;
+    default:
+    {
+        const uint8_t *val = BT_UUID_128(uuid)->val;
+        return static_cast<uint32_t>(val[12]) |
+               static_cast<uint32_t>(val[13]) << 8 |
+               static_cast<uint32_t>(val[14]) << 16 |
+               static_cast<uint32_t>(val[15]) << 24;
+    }
+    }
+}
+
+/**
+ * @brief Emit a trace event that is not bound to a characteristic
+ *
+ * @param name Event name (see @ref event)
+ * @param arg0 First event argument
+ * @param arg1 Second event argument
+ */
+static inline void emit_raw(const char *name, uint32_t arg0, uint32_t arg1)
+{
+#if defined(CONFIG_BLE_UTILS_TRACING)
+    sys_trace_named_event(name, arg0, arg1);
+#else
+    ARG_UNUSED(name);
+    ARG_UNUSED(arg0);
+    ARG_UNUSED(arg1);
+#endif
+}
+
+/**
+ * @brief Emit a trace event
+ *
+ * @param name Event name (see @ref event)
+ * @param uuid UUID of the characteristic
+ * @param arg Event argument (length, result or CCC value)
+ */
+static inline void emit(const char *name, const bt_uuid *uuid, uint32_t arg)
+{
+#if defined(CONFIG_BLE_UTILS_TRACING)
+    emit_raw(name, id(uuid), arg);
+#else
+    ARG_UNUSED(name);
+    ARG_UNUSED(uuid);
+    ARG_UNUSED(arg);
+#endif
+}
+
+/*! Connection index of a completion that is not bound to a connection */
+static constexpr uint32_t NO_CONN{UINT8_MAX};
+
+#if defined(CONFIG_BLE_UTILS_TRACING)
+/*! Sequence number of the last submitted notification or indication */
+inline atomic_t send_seq;
+#endif
+
+/**
+ * @brief Sequence number of the next notification or indication
+ * @details The completions carry the sequence number of their submit, a
+ *          notification to all connections completes once per connection.
+ *
+ * @param cnt Number of consecutive sequence numbers to reserve
+ * @return 16 bit sequence number of the first one, 0 if tracing is disabled
+ */
+static inline uint16_t next_seq(uint16_t cnt = 1)
+{
+#if defined(CONFIG_BLE_UTILS_TRACING)
+    return static_cast<uint16_t>(atomic_add(&send_seq, cnt) + 1);
+#else
+    ARG_UNUSED(cnt);
+    return 0;
+#endif
+}
+
+/**
+ * @brief Sequence numbers stored as the user data of a notification
+ *
+ * @param seq First sequence number
+ * @param cnt Number of values that complete with the notification
+ * @return User data of the notification
+ */
+static inline void *seq_data(uint16_t seq, uint16_t cnt = 1)
+{
+    return reinterpret_cast<void *>(static_cast<uintptr_t>(cnt) << 16 | seq);
+}
+
+/*! @brief First sequence number of the user data set with @ref seq_data */
+static inline uint16_t seq_of(const void *user_data)
+{
+    return static_cast<uint16_t>(reinterpret_cast<uintptr_t>(user_data));
+}
+
+/*! @brief Number of sequence numbers of the user data set with @ref seq_data */
+static inline uint16_t seq_cnt(const void *user_data)
+{
+    return static_cast<uint16_t>(reinterpret_cast<uintptr_t>(user_data) >> 16);
+}
+
+/**
+ * @brief Emit the submit of a notification or indication
+ * @details Emitted after the host accepted the send, a failed send has no event.
+ *
+ * @param name Event name (see @ref event)
+ * @param uuid UUID of the characteristic
+ * @param seq Sequence number from @ref next_seq
+ * @param len Length of the value
+ */
+static inline void emit_submit(const char *name, const bt_uuid *uuid, uint16_t seq, uint16_t len)
+{
+#if defined(CONFIG_BLE_UTILS_TRACING)
+    emit_raw(name, id(uuid), static_cast<uint32_t>(seq) << 16 | len);
+#else
+    ARG_UNUSED(name);
+    ARG_UNUSED(uuid);
+    ARG_UNUSED(seq);
+    ARG_UNUSED(len);
+#endif
+}
+
+/**
+ * @brief Emit the completion of a notification or indication
+ *
+ * @param name Event name (see @ref event)
+ * @param seq Sequence number of the submit
+ * @param conn Connection the value was sent to, nullptr if unknown
+ */
+static inline void emit_done(const char *name, uint16_t seq, bt_conn *conn)
+{
+#if defined(CONFIG_BLE_UTILS_TRACING)
+    emit_raw(name, seq, conn != nullptr ? bt_conn_index(conn) : NO_CONN);
+#else
+    ARG_UNUSED(name);
+    ARG_UNUSED(seq);
+    ARG_UNUSED(conn);
+#endif
+}
+
+} // namespace ble_utils::trace
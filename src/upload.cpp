@@ -0,0 +1,246 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file upload.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/upload.hpp>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(ble_utils_upload, CONFIG_BLEUTILS_LOG_LEVEL);
+
+namespace ble_utils::gatt
+{
+
+using upload::Status;
+
+Upload::DataCharacteristic::DataCharacteristic(const bt_uuid *uuid, Upload &upload):
+    Characteristic(uuid, BT_GATT_CHRC_WRITE_WITHOUT_RESP, BT_GATT_PERM_WRITE),
+    m_upload(upload)
+{
+}
+
+ssize_t Upload::DataCharacteristic::conn_write_cb(bt_conn *conn, const void *buf, uint16_t len,
+                                                  uint16_t offset, uint8_t flags)
+{
+    ARG_UNUSED(flags);
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    return m_upload.chunk(conn, static_cast<const uint8_t *>(buf), len);
+}
+
+Upload::AckCharacteristic::AckCharacteristic(const bt_uuid *uuid, Upload &upload):
+    CharacteristicNotify(uuid, BT_GATT_CHRC_WRITE, BT_GATT_PERM_WRITE),
+    m_upload(upload)
+{
+}
+
+ssize_t Upload::AckCharacteristic::conn_write_cb(bt_conn *conn, const void *buf, uint16_t len,
+                                                 uint16_t offset, uint8_t flags)
+{
+    ARG_UNUSED(flags);
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    return m_upload.control(conn, static_cast<const uint8_t *>(buf), len);
+}
+
+Upload::Upload(const bt_uuid *data_uuid, const bt_uuid *ack_uuid, IUploadSink &sink):
+    m_sink(sink),
+    m_data(data_uuid, *this),
+    m_ack(ack_uuid, *this),
+    m_work{{}, this}
+{
+    k_work_init(&m_work.work, _work_handler);
+}
+
+const Characteristic * Upload::data_chrc() const
+{
+    return &m_data;
+}
+
+const Characteristic * Upload::ack_chrc() const
+{
+    return &m_ack;
+}
+
+Status Upload::status() const
+{
+    return static_cast<Status>(atomic_get(&m_status));
+}
+
+ssize_t Upload::control(bt_conn *conn, const uint8_t *buf, uint16_t len)
+{
+    if (len == 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+    const Status state = status();
+    const bool busy = state == Status::Starting || state == Status::Active;
+    switch (buf[0]) {
+    case upload::OP_START:
+        if (len != upload::START_SIZE) {
+            return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+        }
+        if (busy) {
+            return BT_GATT_ERR(BT_ATT_ERR_PROCEDURE_IN_PROGRESS);
+        }
+        if (m_ack_attr == nullptr) {
+            /* The service keeps its own copy of the attributes */
+            m_ack_attr = bt_gatt_find_by_uuid(nullptr, 0, m_ack.get_uuid());
+        }
+        m_conn = bt_conn_ref(conn);
+        m_size = sys_get_le32(&buf[1]);
+        m_offset = 0;
+        atomic_set(&m_rx_seq, 0);
+        atomic_set(&m_sink_seq, 0);
+        atomic_clear(&m_events);
+        atomic_set(&m_status, static_cast<atomic_val_t>(Status::Starting));
+        break;
+    case upload::OP_ABORT:
+        if (!busy || conn != m_conn) {
+            return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+        }
+        atomic_set_bit(&m_events, EVT_ABORT);
+        break;
+    default:
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+    k_work_submit(&m_work.work);
+    return len;
+}
+
+ssize_t Upload::chunk(bt_conn *conn, const uint8_t *buf, uint16_t len)
+{
+    if (status() != Status::Active || conn != m_conn) {
+        return BT_GATT_ERR(BT_ATT_ERR_WRITE_NOT_PERMITTED);
+    }
+    if (len < upload::CHUNK_HDR_SIZE || len - upload::CHUNK_HDR_SIZE > upload::CHUNK_SIZE) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+    const uint32_t rx_seq = atomic_get(&m_rx_seq);
+    const uint32_t in_flight = rx_seq - static_cast<uint32_t>(atomic_get(&m_sink_seq));
+    if (sys_get_le16(buf) != static_cast<uint16_t>(rx_seq) || in_flight >= upload::WINDOW) {
+        /* Dropped, the repeated ack makes the client go back to the expected chunk */
+        atomic_set_bit(&m_events, EVT_ACK);
+        k_work_submit(&m_work.work);
+        return len;
+    }
+    Slot &slot = m_slots[rx_seq % upload::WINDOW];
+    slot.len = len - upload::CHUNK_HDR_SIZE;
+    memcpy(slot.data, &buf[upload::CHUNK_HDR_SIZE], slot.len);
+    /* Publishes the slot to the work queue */
+    atomic_inc(&m_rx_seq);
+    k_work_submit(&m_work.work);
+    return len;
+}
+
+void Upload::release(uint8_t conn_idx)
+{
+    if (m_conn != nullptr && bt_conn_index(m_conn) == conn_idx) {
+        atomic_set_bit(&m_events, EVT_DISCONNECT);
+        k_work_submit(&m_work.work);
+    }
+}
+
+void Upload::_work_handler(k_work *work)
+{
+    CONTAINER_OF(work, Work, work)->self->process();
+}
+
+void Upload::process()
+{
+    const Status state = status();
+    if (state != Status::Starting && state != Status::Active) {
+        return;
+    }
+    if (atomic_test_and_clear_bit(&m_events, EVT_DISCONNECT)) {
+        finish(-ENOTCONN);
+        return;
+    }
+    if (atomic_test_and_clear_bit(&m_events, EVT_ABORT)) {
+        finish(-ECONNABORTED);
+        return;
+    }
+    if (state == Status::Starting) {
+        const int err = m_sink.begin(m_size);
+        if (err) {
+            finish(err);
+            return;
+        }
+        if (m_size == 0) {
+            finish(0);
+            return;
+        }
+        atomic_set(&m_status, static_cast<atomic_val_t>(Status::Active));
+        ack(Status::Active);
+        return;
+    }
+    const uint32_t sink_seq = atomic_get(&m_sink_seq);
+    const int err = drain();
+    if (err) {
+        finish(err);
+        return;
+    }
+    if (m_offset >= m_size) {
+        finish(0);
+        return;
+    }
+    const bool ack_requested = atomic_test_and_clear_bit(&m_events, EVT_ACK);
+    if (ack_requested || static_cast<uint32_t>(atomic_get(&m_sink_seq)) != sink_seq) {
+        ack(Status::Active);
+    }
+}
+
+int Upload::drain()
+{
+    uint32_t sink_seq = atomic_get(&m_sink_seq);
+    while (sink_seq != static_cast<uint32_t>(atomic_get(&m_rx_seq)) && m_offset < m_size) {
+        const Slot &slot = m_slots[sink_seq % upload::WINDOW];
+        const uint16_t len = MIN(slot.len, m_size - m_offset);
+        const int err = m_sink.write(m_offset, slot.data, len);
+        if (err) {
+            LOG_WRN("Upload sink write failed (err %d)", err);
+            return err;
+        }
+        m_offset += len;
+        sink_seq++;
+        /* Frees the slot for the receive thread */
+        atomic_set(&m_sink_seq, sink_seq);
+    }
+    return 0;
+}
+
+void Upload::finish(int err)
+{
+    const Status state = err ? Status::Error : Status::Complete;
+    m_sink.end(err);
+    ack(state);
+    bt_conn *conn = m_conn;
+    m_conn = nullptr;
+    /* A new transfer can start from here on */
+    atomic_set(&m_status, static_cast<atomic_val_t>(state));
+    bt_conn_unref(conn);
+}
+
+void Upload::ack(Status state)
+{
+    if (m_ack_attr == nullptr) {
+        return;
+    }
+    const uint32_t rx_seq = atomic_get(&m_rx_seq);
+    const uint32_t in_flight = rx_seq - static_cast<uint32_t>(atomic_get(&m_sink_seq));
+    uint8_t frame[upload::ACK_SIZE];
+    sys_put_le16(static_cast<uint16_t>(rx_seq), frame);
+    frame[2] = state == Status::Active ? static_cast<uint8_t>(upload::WINDOW - in_flight) : 0U;
+    frame[3] = static_cast<uint8_t>(state);
+    const int err = bt_gatt_notify_uuid(m_conn, m_ack.get_uuid(), m_ack_attr, frame, sizeof(frame));
+    if (err) {
+        LOG_DBG("Upload ack failed (err %d)", err);
+    }
+}
+
+} // namespace ble_utils::gatt
@@ -0,0 +1,114 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file zbus.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+********************************************************************/
+
+#include <ble_utils/zbus.hpp>
+#include <zephyr/logging/log.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(ble_utils_zbus, CONFIG_BLEUTILS_LOG_LEVEL);
+
+static void ble_utils_zbus_listener_cb(const struct zbus_channel *chan)
+{
+    ble_utils::gatt::zbus_published(chan);
+}
+
+ZBUS_LISTENER_DEFINE(ble_utils_zbus_listener, ble_utils_zbus_listener_cb);
+
+namespace ble_utils::gatt
+{
+
+/*! @brief Time to wait for a channel that is published or read by another thread */
+static constexpr uint32_t CLAIM_TIMEOUT_MS{CONFIG_BLE_UTILS_ZBUS_CLAIM_TIMEOUT_MS};
+static constexpr uint32_t COALESCE_MS{CONFIG_BLE_UTILS_ZBUS_COALESCE_MS};
+/*! @brief Retry delay when no notification buffers are available */
+static constexpr uint32_t RETRY_MS{1U};
+
+/*! @brief Head of the notify characteristics bound to channels */
+static ZbusCharacteristicNotify *bound;
+
+/**
+ * @brief Read a channel message into an attribute read
+ *
+ * @param chan Channel with the value
+ * @param buf Buffer to place the read result in
+ * @param len Length of data to read
+ * @param offset Offset to start reading from
+ * @return Number of bytes read or BT_GATT_ERR()
+ */
+static ssize_t read_chan(const zbus_channel &chan, void *buf, uint16_t len, uint16_t offset)
+{
+    const size_t size = zbus_chan_msg_size(&chan);
+    if (offset > size) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    if (zbus_chan_claim(&chan, K_MSEC(CLAIM_TIMEOUT_MS)) != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+    }
+    const uint16_t read_len = MIN(len, size - offset);
+    memcpy(buf, static_cast<const uint8_t *>(zbus_chan_const_msg(&chan)) + offset, read_len);
+    zbus_chan_finish(&chan);
+    return read_len;
+}
+
+ZbusCharacteristic::ZbusCharacteristic(const bt_uuid * uuid, const zbus_channel &chan,
+                                       uint8_t props, uint8_t perm):
+    Characteristic(uuid, props | BT_GATT_CHRC_READ, perm | BT_GATT_PERM_READ),
+    m_chan(chan)
+{
+}
+
+ssize_t ZbusCharacteristic::read_cb(void *buf, uint16_t len, uint16_t offset)
+{
+    return read_chan(m_chan, buf, len, offset);
+}
+
+ZbusCharacteristicNotify::ZbusCharacteristicNotify(const bt_uuid * uuid, const zbus_channel &chan,
+                                                   uint8_t props, uint8_t perm):
+    CharacteristicNotify(uuid, props | BT_GATT_CHRC_READ, perm | BT_GATT_PERM_READ),
+    m_chan(chan),
+    m_work{{}, this},
+    m_next(bound)
+{
+    k_work_init_delayable(&m_work.work, _notify_handler);
+    bound = this;
+}
+
+ssize_t ZbusCharacteristicNotify::read_cb(void *buf, uint16_t len, uint16_t offset)
+{
+    return read_chan(m_chan, buf, len, offset);
+}
+
+void zbus_published(const zbus_channel *chan)
+{
+    for (ZbusCharacteristicNotify *chrc = bound; chrc != nullptr; chrc = chrc->m_next) {
+        if (&chrc->m_chan == chan) {
+            /* A pending notification sends the newest message, so the publish is coalesced */
+            k_work_schedule(&chrc->m_work.work, K_MSEC(COALESCE_MS));
+        }
+    }
+}
+
+void ZbusCharacteristicNotify::_notify_handler(k_work *work)
+{
+    k_work_delayable *dwork = k_work_delayable_from_work(work);
+    auto instance = CONTAINER_OF(dwork, NotifyWork, work)->chrc;
+    const zbus_channel *chan = &instance->m_chan;
+    if (zbus_chan_claim(chan, K_MSEC(CLAIM_TIMEOUT_MS)) != 0) {
+        k_work_schedule(dwork, K_MSEC(RETRY_MS));
+        return;
+    }
+    /* The host copies the message into the notification buffer while the channel is held */
+    const int err = instance->notify(zbus_chan_const_msg(chan), zbus_chan_msg_size(chan));
+    zbus_chan_finish(chan);
+    if (err == -ENOMEM) {
+        k_work_schedule(dwork, K_MSEC(RETRY_MS));
+    } else if (err && err != -ENOTCONN) {
+        LOG_DBG("zbus notification failed (err %d)", err);
+    }
+}
+
+} // namespace ble_utils::gatt
@@ -0,0 +1,128 @@
+/*!*****************************************************************
+* Copyright 2024 Victor Chavez
+* SPDX-License-Identifier: Apache-2.0
+* @file main.cpp
+* @author Victor Chavez (vchavezb@protonmail.com)
+*
+* @brief
+* Footprint benchmark of the BLE Utils module. FOOTPRINT_PLAIN, FOOTPRINT_NOTIFY
+* and FOOTPRINT_INDICATE characteristics are registered round robin to
+* FOOTPRINT_SERVICES services. The objects have C linkage, so
+* scripts/footprint.py finds their size in the ELF.
+*
+* @par Dependencies
+* - language: C++17
+* - OS: Zephyr v3.7.x
+********************************************************************/
+
+#include <ble_utils/ble_utils.hpp>
+#include <ble_utils/uuid.hpp>
+#include <zephyr/bluetooth/bluetooth.h>
+
+static_assert(FOOTPRINT_SERVICES > 0, "At least one service is required");
+
+namespace footprint
+{
+
+namespace uuid
+{
+    static constexpr bt_uuid_128 svc = ble_utils::uuid::uuid128_init(0xF0070000,
+                                                                     0x1234,
+                                                                     0x5678,
+                                                                     0x9ABC,
+                                                                     0xDEF012345678);
+    static constexpr bt_uuid_128 chrc = ble_utils::uuid::derive_uuid(svc, 0x0001);
+}
+
+class Plain final: public ble_utils::gatt::Characteristic
+{
+public:
+    Plain():
+        ble_utils::gatt::Characteristic((const bt_uuid*)&uuid::chrc,
+                                        BT_GATT_CHRC_READ,
+                                        BT_GATT_PERM_READ)
+    {
+    }
+private:
+    ssize_t read_cb(void *buf, uint16_t len, uint16_t offset) override
+    {
+        ARG_UNUSED(buf);
+        ARG_UNUSED(len);
+        ARG_UNUSED(offset);
+        return 0;
+    }
+};
+
+class Notify final: public ble_utils::gatt::CharacteristicNotify
+{
+public:
+    Notify():
+        ble_utils::gatt::CharacteristicNotify((const bt_uuid*)&uuid::chrc)
+    {
+    }
+};
+
+class Indicate final: public ble_utils::gatt::CharacteristicIndicate
+{
+public:
+    Indicate():
+        ble_utils::gatt::CharacteristicIndicate((const bt_uuid*)&uuid::chrc)
+    {
+    }
+};
+
+class Service final: public ble_utils::gatt::Service
+{
+public:
+    Service():
+        ble_utils::gatt::Service((const bt_uuid*)&uuid::svc)
+    {
+    }
+};
+
+} // namespace footprint
+
+extern "C" {
+#if FOOTPRINT_PLAIN > 0
+footprint::Plain footprint_plain[FOOTPRINT_PLAIN];
+#endif
+#if FOOTPRINT_NOTIFY > 0
+footprint::Notify footprint_notify[FOOTPRINT_NOTIFY];
+#endif
+#if FOOTPRINT_INDICATE > 0
+footprint::Indicate footprint_indicate[FOOTPRINT_INDICATE];
+#endif
+footprint::Service footprint_services[FOOTPRINT_SERVICES];
+}
+
+int main(void)
+{
+    size_t idx = 0;
+#if FOOTPRINT_PLAIN > 0
+    for (auto &chrc : footprint_plain) {
+        footprint_services[idx++ % FOOTPRINT_SERVICES].register_char(&chrc);
+    }
+#endif
+#if FOOTPRINT_NOTIFY > 0
+    for (auto &chrc : footprint_notify) {
+        footprint_services[idx++ % FOOTPRINT_SERVICES].register_char(&chrc);
+    }
+#endif
+#if FOOTPRINT_INDICATE > 0
+    for (auto &chrc : footprint_indicate) {
+        footprint_services[idx++ % FOOTPRINT_SERVICES].register_char(&chrc);
+    }
+#endif
+    ARG_UNUSED(idx);
+    int err = bt_enable(nullptr);
+    if (err) {
+        return err;
+    }
+    for (auto &svc : footprint_services) {
+        err = svc.init();
+        if (err) {
+            return err;
+        }
+    }
+    return 0;
+}
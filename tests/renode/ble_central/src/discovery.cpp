@@ -11,8 +11,13 @@
 #include <zephyr/sys/byteorder.h>
 #include <zephyr/logging/log.h>
 #include <string>
+#include <ble_utils/scanner.hpp>
+#include <ble_utils/notify_router.hpp>
 #include "discovery.hpp"
 #include "uptime_service.hpp"
+#if defined(CONFIG_APP_LOAD_GEN)
+#include "load_gen.hpp"
+#endif
 
 LOG_MODULE_REGISTER(central, CONFIG_LOG_DEFAULT_LEVEL);
 
@@ -25,7 +30,6 @@ static uint8_t device_char_cnt;
 
 
 static bt_gatt_discover_params discover_params;
-static bt_gatt_subscribe_params subscribe_params;
 
 static constexpr bt_le_conn_param conn_default_param =
 {
@@ -45,36 +49,51 @@ static constexpr bt_conn_le_create_param conn_create_param =
 	.timeout=0
 };
 
+#if defined(CONFIG_APP_LOAD_GEN)
+static constexpr uint8_t TOTAL_CHARACTERISTICS = 4;
+/* Value handle of the basic characteristic, read by the load generator */
+static uint16_t read_handle;
+#else
 static constexpr uint8_t TOTAL_CHARACTERISTICS = 3;
+#endif
 static const bt_uuid * uptime_characteristics [TOTAL_CHARACTERISTICS] =
 {
 	&uptime::uuid::char_basic.uuid,
 	&uptime::uuid::char_indicate.uuid,
-	&uptime::uuid::char_notify.uuid
+	&uptime::uuid::char_notify.uuid,
+#if defined(CONFIG_APP_LOAD_GEN)
+	&uptime::uuid::char_write.uuid
+#endif
 };
 
-static uint8_t uptime_notify_cb(bt_conn *conn,
-			   				bt_gatt_subscribe_params *params,
-			   				const void *data, uint16_t length)
+class UptimeHandler final : public ble_utils::client::INotificationHandler
 {
-	if (conn == NULL) {
-		return BT_GATT_ITER_CONTINUE;
+	void notification(bt_conn *conn, uint16_t value_handle,
+			  const void *data, uint16_t length) override
+	{
+		ARG_UNUSED(conn);
+		ARG_UNUSED(value_handle);
+		if(length != sizeof(uint32_t)) {
+			LOG_ERR("Uptime data len %d does not match expected len %d", length,sizeof(uint32_t));
+			return;
+		}
+		const uint32_t uptime = sys_get_le32((uint8_t*)(data));
+		LOG_INF("Notification Uptime value %d", uptime);
+#if defined(CONFIG_APP_LOAD_GEN)
+		load_gen::notification(length);
+#endif
 	}
 
-	if (!data) {
+	void unsubscribed(bt_conn *conn, uint16_t value_handle) override
+	{
+		ARG_UNUSED(conn);
+		ARG_UNUSED(value_handle);
 		LOG_INF("Unsubscribed");
-		params->value_handle = 0U;
-		return BT_GATT_ITER_CONTINUE;
 	}
+};
 
-	if(length != sizeof(uint32_t)) {
-		LOG_ERR("Uptime data len %d does not match expected len %d", length,sizeof(uint32_t));
-		return BT_GATT_ITER_STOP;
-	}
-	const uint32_t uptime = sys_get_le32((uint8_t*)(data));
-	LOG_INF("Notification Uptime value %d", uptime);
-	return BT_GATT_ITER_CONTINUE;
-}
+static UptimeHandler uptime_handler;
+static ble_utils::client::NotificationRouter router;
 
 static int discover_characteristics(bt_conn *conn,
 								const bt_gatt_attr *attr,
@@ -120,18 +139,32 @@ static uint8_t service_discover_cb(bt_conn *conn,
 		if (bt_uuid_cmp(params->uuid,
 						&uptime::uuid::char_notify.uuid) == 0) {
 			// Subscribe to uptime notification
-			subscribe_params.notify = uptime_notify_cb;
-			subscribe_params.value = BT_GATT_CCC_NOTIFY;
-			subscribe_params.ccc_handle = attr->handle+2;
-			subscribe_params.value_handle = bt_gatt_attr_value_handle(attr);
-			const int err = bt_gatt_subscribe(conn, &subscribe_params);
+			const int err = router.subscribe(conn,
+							 bt_gatt_attr_value_handle(attr),
+							 attr->handle+2,
+							 BT_GATT_CCC_NOTIFY,
+							 uptime_handler);
 			if (err != 0 && err != -EALREADY) {
 				LOG_ERR("Subscribe failed (err %d)", err);
 			} else {
 				LOG_INF("Subscribed");
 			}
+#if !defined(CONFIG_APP_LOAD_GEN)
 			return BT_GATT_ITER_STOP;
+#endif
 		}
+#if defined(CONFIG_APP_LOAD_GEN)
+		if (bt_uuid_cmp(params->uuid, &uptime::uuid::char_basic.uuid) == 0) {
+			read_handle = bt_gatt_attr_value_handle(attr);
+		} else if (bt_uuid_cmp(params->uuid, &uptime::uuid::char_write.uuid) == 0) {
+			const int err = load_gen::start(conn, read_handle,
+							bt_gatt_attr_value_handle(attr));
+			if (err != 0 && err != -EALREADY) {
+				LOG_ERR("Load generator start failed (err %d)", err);
+			}
+			return BT_GATT_ITER_STOP;
+		}
+#endif
 		if (device_char_cnt == TOTAL_CHARACTERISTICS-1) {
 			device_found = true;
 		} else if (device_char_cnt < TOTAL_CHARACTERISTICS) {
@@ -144,61 +177,41 @@ static uint8_t service_discover_cb(bt_conn *conn,
 
 
 
-static bool adv_data_cb(bt_data *data, void *user_data)
+/* Service UUIDs that the central connects to */
+using uptime_filter = ble_utils::scan::UuidFilter<uptime::uuid::svc_base>;
+
+class UptimeScanner final : public ble_utils::scan::Scanner
 {
-	auto addr = static_cast<bt_addr_le_t*>(user_data);
-	LOG_INF("Adv data type %u len %u", data->type, data->data_len);
-	switch (data->type) {
-	case BT_DATA_UUID128_SOME:
-	case BT_DATA_UUID128_ALL:
-		if (data->data_len % BT_UUID_SIZE_128 != 0U) {
-			LOG_INF("AD malformed");
-			return true;
+public:
+	UptimeScanner() : ble_utils::scan::Scanner(uptime_filter::table) {}
+private:
+	void device_found(const bt_le_scan_recv_info *info, net_buf_simple *ad) override
+	{
+		ARG_UNUSED(ad);
+		/* Only reports of a connectable advertiser */
+		if (info->adv_type != BT_GAP_ADV_TYPE_ADV_IND &&
+		    info->adv_type != BT_GAP_ADV_TYPE_ADV_DIRECT_IND &&
+		    info->adv_type != BT_GAP_ADV_TYPE_SCAN_RSP) {
+			return;
+		}
+		LOG_INF("Matched Uptime adv. UUID");
+		int err = stop();
+		if (err) {
+			LOG_INF("Stop LE scan failed (err %d)", err);
+			return;
 		}
-		for (int i = 0; i < data->data_len; i += BT_UUID_SIZE_128) {
-			int err;
-
-			bt_uuid_128 adv_uuid ={	.uuid = { BT_UUID_TYPE_128 }};
-			memcpy(adv_uuid.val, data->data+i, BT_UUID_SIZE_128);
-			const int uuid_match = bt_uuid_cmp(&adv_uuid.uuid, &uptime::uuid::svc_base.uuid);
-			if (uuid_match != 0) {
-				continue;
-			}
-			LOG_INF("Matched Uptime adv. UUID");
-			err = bt_le_scan_stop();
-			if (err) {
-				LOG_INF("Stop LE scan failed (err %d)", err);
-				return false;
-			}
 
-			LOG_INF("Connecting..");
-			err = bt_conn_le_create(addr, &conn_create_param,
-						&conn_default_param, &default_conn);
-			if (err) {
-				LOG_ERR("Create conn failed (err %d)", err);
-				start_scan();
-			}
-			return false;
+		LOG_INF("Connecting..");
+		err = bt_conn_le_create(info->addr, &conn_create_param,
+					&conn_default_param, &default_conn);
+		if (err) {
+			LOG_ERR("Create conn failed (err %d)", err);
+			start_scan();
 		}
 	}
-	return true;
-}
-
-static void device_found_cb(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
-			 net_buf_simple *ad)
-{
-	char dev[BT_ADDR_LE_STR_LEN];
-
-	bt_addr_le_to_str(addr, dev, sizeof(dev));
-	//LOG_INF("[DEVICE]: %s, AD evt type %u, AD data len %u, RSSI %i",
-	//       dev, type, ad->len, rssi);
+};
 
-	if (type == BT_GAP_ADV_TYPE_ADV_IND ||
-	    type == BT_GAP_ADV_TYPE_ADV_DIRECT_IND ||
-		type == BT_GAP_ADV_TYPE_SCAN_RSP) {
-		bt_data_parse(ad, adv_data_cb, (void *)addr);
-	}
-}
+static UptimeScanner scanner;
 
 int start_scan()
 {
@@ -213,7 +226,7 @@ int start_scan()
 		.window     = BT_GAP_SCAN_FAST_WINDOW,
 	};
 
-	err = bt_le_scan_start(&scan_param, device_found_cb);
+	err = scanner.start(scan_param);
 	if (err) {
 		LOG_ERR("Scanning failed to start (err %d)", err);
 		return err;
@@ -273,6 +286,9 @@ static void disconnected(bt_conn *conn, uint8_t reason)
 		return;
 	}
 
+#if defined(CONFIG_APP_LOAD_GEN)
+	load_gen::stop();
+#endif
 	bt_conn_unref(default_conn);
 	default_conn = NULL;
 
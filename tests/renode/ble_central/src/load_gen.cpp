@@ -0,0 +1,316 @@
+/*
+    Copyright (c) 2024 Victor Chavez
+    SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+#include "load_gen.hpp"
+
+LOG_MODULE_REGISTER(load_gen, CONFIG_LOG_DEFAULT_LEVEL);
+
+namespace load_gen {
+
+static constexpr uint32_t RATE = CONFIG_APP_LOAD_GEN_RATE;
+static constexpr uint32_t DURATION_S = CONFIG_APP_LOAD_GEN_DURATION_S;
+static constexpr uint32_t REPORT_S = CONFIG_APP_LOAD_GEN_REPORT_S;
+static constexpr uint16_t WRITE_LEN = CONFIG_APP_LOAD_GEN_WRITE_LEN;
+
+/* Latency buckets of powers of two in microseconds, the last one holds all above */
+static constexpr uint8_t BUCKETS = 24;
+
+enum Op : uint8_t
+{
+	OP_READ,
+	OP_WRITE,
+	OP_WRITE_CMD,
+	OP_TOTAL
+};
+
+static const char * const op_name[OP_TOTAL] =
+{
+	"read",
+	"write",
+	"write cmd"
+};
+
+struct Stats
+{
+	uint32_t ok;
+	uint32_t err;
+	/* Requests skipped because the previous one is pending or the host has no buffers */
+	uint32_t busy;
+	uint32_t bytes;
+	uint32_t hist[BUCKETS];
+};
+
+static Stats stats[OP_TOTAL];
+static uint32_t notify_cnt;
+static uint32_t notify_bytes;
+static uint32_t report_start;
+static uint32_t run_start;
+
+static bt_conn *load_conn;
+static uint16_t write_handle;
+static uint8_t next_op;
+static bool running;
+
+static bt_gatt_read_params read_params;
+static bt_gatt_write_params write_params;
+static atomic_t pending;
+static uint32_t sent_at[OP_TOTAL];
+static uint8_t write_data[WRITE_LEN];
+
+static void issue_handler(k_work *work);
+static void report_handler(k_work *work);
+static void tick(k_timer *timer);
+
+static K_WORK_DEFINE(issue_work, issue_handler);
+static K_WORK_DELAYABLE_DEFINE(report_work, report_handler);
+static K_TIMER_DEFINE(rate_timer, tick, nullptr);
+/* Stats are updated from the BT RX thread and read by the report work */
+static K_SPINLOCK_DEFINE(stats_lock);
+
+static uint8_t bucket(uint32_t us)
+{
+	uint8_t idx = 0;
+	while (us > 1U && idx < BUCKETS - 1) {
+		us >>= 1;
+		idx++;
+	}
+	return idx;
+}
+
+static void complete(Op op, int err, uint16_t length)
+{
+	const uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - sent_at[op]);
+	k_spinlock_key_t key = k_spin_lock(&stats_lock);
+	Stats &s = stats[op];
+	if (err) {
+		s.err++;
+	} else {
+		s.ok++;
+		s.bytes += length;
+		s.hist[bucket(us)]++;
+	}
+	k_spin_unlock(&stats_lock, key);
+	atomic_clear_bit(&pending, op);
+}
+
+/**
+ * @brief Upper bound of the bucket where a percentile of the samples falls
+ *
+ * @return Latency in microseconds or 0 without samples
+ */
+static uint32_t percentile(const Stats &s, uint8_t pct)
+{
+	if (s.ok == 0) {
+		return 0;
+	}
+	const uint32_t rank = DIV_ROUND_UP(s.ok * pct, 100U);
+	uint32_t cnt = 0;
+	for (uint8_t i = 0; i < BUCKETS; i++) {
+		cnt += s.hist[i];
+		if (cnt >= rank) {
+			return 2U << i;
+		}
+	}
+	return 2U << (BUCKETS - 1);
+}
+
+static uint8_t read_cb(bt_conn *conn, uint8_t err,
+		       bt_gatt_read_params *params,
+		       const void *data, uint16_t length)
+{
+	ARG_UNUSED(conn);
+	ARG_UNUSED(params);
+	/* With a complete value the read is finished without a further callback */
+	if (err || data != nullptr) {
+		complete(OP_READ, err, length);
+	}
+	return BT_GATT_ITER_STOP;
+}
+
+static void write_cb(bt_conn *conn, uint8_t err, bt_gatt_write_params *params)
+{
+	ARG_UNUSED(conn);
+	complete(OP_WRITE, err, params->length);
+}
+
+static void write_cmd_cb(bt_conn *conn, void *user_data)
+{
+	ARG_UNUSED(conn);
+	ARG_UNUSED(user_data);
+	complete(OP_WRITE_CMD, 0, WRITE_LEN);
+}
+
+static void count_busy(Op op, int err)
+{
+	k_spinlock_key_t key = k_spin_lock(&stats_lock);
+	if (err == -ENOMEM || err == -ENOBUFS || err == -EBUSY) {
+		stats[op].busy++;
+	} else {
+		stats[op].err++;
+	}
+	k_spin_unlock(&stats_lock, key);
+}
+
+static int issue(Op op)
+{
+	sent_at[op] = k_cycle_get_32();
+	switch (op) {
+	case OP_READ:
+		return bt_gatt_read(load_conn, &read_params);
+	case OP_WRITE:
+		sys_put_le32(sent_at[op], write_data);
+		return bt_gatt_write(load_conn, &write_params);
+	case OP_WRITE_CMD:
+		sys_put_le32(sent_at[op], write_data);
+		return bt_gatt_write_without_response_cb(load_conn, write_handle,
+							 write_data, WRITE_LEN,
+							 false, write_cmd_cb, nullptr);
+	default:
+		return -EINVAL;
+	}
+}
+
+static void issue_handler(k_work *work)
+{
+	ARG_UNUSED(work);
+	if (!running) {
+		return;
+	}
+	const Op op = static_cast<Op>(next_op);
+	next_op = (next_op + 1) % OP_TOTAL;
+	/* One request of each kind in flight, a pending one means the link is saturated */
+	if (atomic_test_and_set_bit(&pending, op)) {
+		count_busy(op, -EBUSY);
+		return;
+	}
+	const int err = issue(op);
+	if (err) {
+		atomic_clear_bit(&pending, op);
+		count_busy(op, err);
+		LOG_DBG("%s failed (err %d)", op_name[op], err);
+	}
+}
+
+static void tick(k_timer *timer)
+{
+	ARG_UNUSED(timer);
+	k_work_submit(&issue_work);
+}
+
+static void report()
+{
+	Stats snap[OP_TOTAL];
+	k_spinlock_key_t key = k_spin_lock(&stats_lock);
+	memcpy(snap, stats, sizeof(snap));
+	memset(stats, 0, sizeof(stats));
+	const uint32_t notifications = notify_cnt;
+	const uint32_t notified_bytes = notify_bytes;
+	notify_cnt = 0;
+	notify_bytes = 0;
+	k_spin_unlock(&stats_lock, key);
+
+	const uint32_t now = k_uptime_get_32();
+	const uint32_t elapsed_ms = MAX(now - report_start, 1U);
+	report_start = now;
+
+	for (uint8_t op = 0; op < OP_TOTAL; op++) {
+		const Stats &s = snap[op];
+		LOG_INF("%s: %u ok/s, %u B/s, %u err, %u busy, p50 %u us, p90 %u us, p99 %u us",
+			op_name[op],
+			s.ok * MSEC_PER_SEC / elapsed_ms,
+			s.bytes * MSEC_PER_SEC / elapsed_ms,
+			s.err,
+			s.busy,
+			percentile(s, 50),
+			percentile(s, 90),
+			percentile(s, 99));
+	}
+	LOG_INF("notify: %u/s, %u B/s",
+		notifications * MSEC_PER_SEC / elapsed_ms,
+		notified_bytes * MSEC_PER_SEC / elapsed_ms);
+}
+
+static void report_handler(k_work *work)
+{
+	ARG_UNUSED(work);
+	if (!running) {
+		return;
+	}
+	report();
+	if (DURATION_S != 0 && k_uptime_get_32() - run_start >= DURATION_S * MSEC_PER_SEC) {
+		stop();
+		return;
+	}
+	k_work_schedule(&report_work, K_SECONDS(REPORT_S));
+}
+
+int start(bt_conn *conn, uint16_t read_handle, uint16_t write_value_handle)
+{
+	if (running) {
+		return -EALREADY;
+	}
+	load_conn = bt_conn_ref(conn);
+	write_handle = write_value_handle;
+
+	read_params = {};
+	read_params.func = read_cb;
+	read_params.handle_count = 1;
+	read_params.single.handle = read_handle;
+	read_params.single.offset = 0;
+
+	write_params = {};
+	write_params.func = write_cb;
+	write_params.handle = write_handle;
+	write_params.offset = 0;
+	write_params.data = write_data;
+	write_params.length = WRITE_LEN;
+
+	memset(stats, 0, sizeof(stats));
+	notify_cnt = 0;
+	notify_bytes = 0;
+	atomic_clear(&pending);
+	next_op = OP_READ;
+	run_start = k_uptime_get_32();
+	report_start = run_start;
+	running = true;
+
+	/* Each kind of request is issued at the target rate */
+	const k_timeout_t period = K_USEC(USEC_PER_SEC / (RATE * OP_TOTAL));
+	k_timer_start(&rate_timer, period, period);
+	k_work_schedule(&report_work, K_SECONDS(REPORT_S));
+	LOG_INF("Load generator started, %u req/s per kind, %u byte writes", RATE, WRITE_LEN);
+	return 0;
+}
+
+void stop()
+{
+	if (!running) {
+		return;
+	}
+	running = false;
+	k_timer_stop(&rate_timer);
+	k_work_cancel_delayable(&report_work);
+	report();
+	bt_conn_unref(load_conn);
+	load_conn = nullptr;
+	LOG_INF("Load generator stopped");
+}
+
+void notification(uint16_t length)
+{
+	k_spinlock_key_t key = k_spin_lock(&stats_lock);
+	notify_cnt++;
+	notify_bytes += length;
+	k_spin_unlock(&stats_lock, key);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+/*
+    Copyright (c) 2024 Victor Chavez
+    SPDX-License-Identifier: Apache-2.0
+*/
+
+#pragma once
+
+#include <zephyr/bluetooth/conn.h>
+
+namespace load_gen {
+
+/**
+ * @brief Start issuing reads, writes and writes without response at the configured rate
+ *
+ * @param conn Connection to the uptime peripheral
+ * @param read_handle Value handle of the uptime basic characteristic
+ * @param write_handle Value handle of the uptime write characteristic
+ * @return 0 on success or -EALREADY if the load generator runs
+ */
+int start(bt_conn *conn, uint16_t read_handle, uint16_t write_handle);
+
+/**
+ * @brief Stop the load generator and log the last report
+ */
+void stop();
+
+/**
+ * @brief Account a received notification
+ *
+ * @param length Length of the notification
+ */
+void notification(uint16_t length);
+
+
+}
\ No newline at end of file